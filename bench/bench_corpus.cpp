@@ -0,0 +1,216 @@
+#include <array>
+#include <string_view>
+
+#include "bench_corpus.h"
+
+namespace {
+
+  class Random {
+  public:
+    explicit Random(uint64_t seed)
+      : state_{ seed }
+    {
+    }
+
+    uint64_t Next()
+    {
+      state_ ^= state_ << 13;
+      state_ ^= state_ >> 7;
+      state_ ^= state_ << 17;
+      return state_;
+    }
+
+    uint64_t Below(uint64_t bound)
+    {
+      return Next() % bound;
+    }
+
+  private:
+    uint64_t state_;
+  };
+
+  constexpr std::array<std::string_view, 16> words = {
+    "request", "served", "cache", "miss", "user", "session", "expired", "retry",
+    "upstream", "timeout", "connection", "reset", "payload", "accepted", "queue", "flushed"
+  };
+
+  constexpr std::array<std::string_view, 4> levels = { "DEBUG", "INFO", "WARN", "ERROR" };
+
+  // Fixed-point decimal such as -1234.567, avoids locale and float formatting differences
+  void AppendDecimal(std::string& out, Random& random)
+  {
+    if (random.Below(4) == 0) out.append(1, '-');
+    out += std::to_string(random.Below(100000));
+    out.append(1, '.');
+
+    auto fraction = std::to_string(random.Below(1000));
+    out.append(3 - fraction.size(), '0');
+    out += fraction;
+  }
+
+  void AppendSentence(std::string& out, Random& random, size_t word_count)
+  {
+    for (size_t i = 0; i < word_count; i++)
+    {
+      if (i != 0) out.append(1, ' ');
+      out += words[random.Below(words.size())];
+    }
+  }
+
+  void AppendLogRecord(std::string& out, Random& random, uint64_t index)
+  {
+    out += "{\"ts\":\"2024-01-01T00:00:";
+    out += std::to_string(10 + index % 50);
+    out += "Z\",\"level\":\"";
+    out += levels[random.Below(levels.size())];
+    out += "\",\"id\":";
+    out += std::to_string(index);
+    out += ",\"msg\":\"";
+    AppendSentence(out, random, 8 + random.Below(24));
+    out += "\",\"ok\":";
+    out += random.Below(2) ? "true" : "false";
+    out += ",\"latency\":";
+    AppendDecimal(out, random);
+    out += "}";
+  }
+}
+
+BenchCorpus::Corpus BenchCorpus::DeepNesting(size_t scale)
+{
+  Corpus corpus{ "deep_nesting", {}, {}, {} };
+  size_t depth = 256;
+  size_t copies = 64 * scale;
+
+  corpus.text = "{";
+  for (size_t copy = 0; copy < copies; copy++)
+  {
+    if (copy != 0) corpus.text.append(1, ',');
+
+    auto key = "tree" + std::to_string(copy);
+    corpus.keys.push_back(key);
+    corpus.text += "\"" + key + "\":";
+
+    for (size_t level = 0; level < depth; level++)
+    {
+      corpus.text += "{\"level\":" + std::to_string(level) + ",\"child\":";
+    }
+    corpus.text += "null";
+    corpus.text.append(depth, '}');
+  }
+  corpus.text += "}";
+
+  return corpus;
+}
+
+BenchCorpus::Corpus BenchCorpus::WideObject(size_t scale)
+{
+  Corpus corpus{ "wide_object", {}, {}, {} };
+  Random random{ 0x9E3779B97F4A7C15ull };
+  size_t width = 20000 * scale;
+
+  corpus.text = "{";
+  for (size_t i = 0; i < width; i++)
+  {
+    if (i != 0) corpus.text.append(1, ',');
+
+    auto key = "field_" + std::to_string(i);
+    corpus.keys.push_back(key);
+    corpus.text += "\"" + key + "\":";
+
+    switch (random.Below(4))
+    {
+    case 0:
+      AppendDecimal(corpus.text, random);
+      break;
+    case 1:
+      corpus.text += "\"";
+      AppendSentence(corpus.text, random, 1 + random.Below(4));
+      corpus.text += "\"";
+      break;
+    case 2:
+      corpus.text += random.Below(2) ? "true" : "false";
+      break;
+    default:
+      corpus.text += "null";
+      break;
+    }
+  }
+  corpus.text += "}";
+
+  return corpus;
+}
+
+BenchCorpus::Corpus BenchCorpus::NumericArray(size_t scale)
+{
+  Corpus corpus{ "numeric_array", {}, {}, {} };
+  Random random{ 0xD1B54A32D192ED03ull };
+  size_t rows = 64 * scale;
+  size_t row_size = 1024;
+
+  corpus.text = "{";
+  for (size_t row = 0; row < rows; row++)
+  {
+    if (row != 0) corpus.text.append(1, ',');
+
+    auto key = "embedding" + std::to_string(row);
+    corpus.keys.push_back(key);
+    corpus.text += "\"" + key + "\":[";
+
+    for (size_t i = 0; i < row_size; i++)
+    {
+      if (i != 0) corpus.text.append(1, ',');
+      AppendDecimal(corpus.text, random);
+    }
+    corpus.text += "]";
+  }
+  corpus.text += "}";
+
+  return corpus;
+}
+
+BenchCorpus::Corpus BenchCorpus::StringLogs(size_t scale)
+{
+  Corpus corpus{ "string_logs", {}, {}, {} };
+  Random random{ 0x8CB92BA72F3D8DD7ull };
+  size_t records = 10000 * scale;
+
+  corpus.text = "{\"records\":[";
+  for (size_t i = 0; i < records; i++)
+  {
+    if (i != 0) corpus.text.append(1, ',');
+    AppendLogRecord(corpus.text, random, i);
+  }
+  corpus.text += "]}";
+  corpus.keys.push_back("records");
+
+  return corpus;
+}
+
+BenchCorpus::Corpus BenchCorpus::Ndjson(size_t scale)
+{
+  Corpus corpus{ "ndjson", {}, {}, {} };
+  Random random{ 0xA0761D6478BD642Full };
+  size_t records = 10000 * scale;
+
+  corpus.lines.reserve(records);
+  for (size_t i = 0; i < records; i++)
+  {
+    std::string line;
+    AppendLogRecord(line, random, i);
+    corpus.lines.push_back(std::move(line));
+  }
+  corpus.keys = { "ts", "level", "id", "msg", "ok", "latency" };
+
+  return corpus;
+}
+
+std::vector<BenchCorpus::Corpus> BenchCorpus::All(size_t scale)
+{
+  std::vector<Corpus> corpora;
+  corpora.push_back(DeepNesting(scale));
+  corpora.push_back(WideObject(scale));
+  corpora.push_back(NumericArray(scale));
+  corpora.push_back(StringLogs(scale));
+  corpora.push_back(Ndjson(scale));
+  return corpora;
+}
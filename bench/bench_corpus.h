@@ -0,0 +1,32 @@
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/*
+ * Deterministic synthetic corpora for toolkit_bench.
+ * Every generator uses a fixed-seed xorshift generator and only integer
+ * arithmetic, so the produced text is byte-identical on every platform.
+ */
+namespace BenchCorpus {
+
+  struct Corpus {
+    std::string name;
+    std::string text;                 // Whole document (empty for line-delimited corpora)
+    std::vector<std::string> lines;   // NDJSON records
+    std::vector<std::string> keys;    // Top-level keys usable for lookups
+  };
+
+  /* scale multiplies the default size of every corpus */
+  Corpus DeepNesting(size_t scale);
+  Corpus WideObject(size_t scale);
+  Corpus NumericArray(size_t scale);
+  Corpus StringLogs(size_t scale);
+  Corpus Ndjson(size_t scale);
+
+  std::vector<Corpus> All(size_t scale);
+}
+
+#endif // !BENCH_CORPUS_H
@@ -0,0 +1,381 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+
+#include "json.h"
+#include "bench_corpus.h"
+
+/*
+ * toolkit_bench - microbenchmarks for the Json module.
+ *
+ *   toolkit_bench [--format table|csv|json] [--scale N] [--min-time SECONDS] [--filter TEXT]
+ *
+ * Every operation runs on the deterministic corpora from bench_corpus.h.
+ * Allocation counts come from the replaced global operator new below and
+ * are reported per iteration.
+ */
+
+namespace {
+  std::atomic<size_t> allocation_count{ 0 };
+  std::atomic<size_t> allocation_bytes{ 0 };
+}
+
+void* operator new(size_t size)
+{
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+  std::free(ptr);
+}
+
+namespace {
+
+  using Clock = std::chrono::steady_clock;
+
+  enum class OutputFormat {
+    Table,
+    Csv,
+    Json,
+  };
+
+  struct Options {
+    OutputFormat format = OutputFormat::Table;
+    size_t scale = 1;
+    double min_time = 0.5;
+    std::string filter;
+  };
+
+  struct Result {
+    std::string corpus;
+    std::string operation;
+    size_t iterations;
+    double median_seconds;
+    size_t bytes;           // Bytes processed per iteration
+    size_t items;           // Nodes or lookups processed per iteration
+    double allocations;     // Per iteration
+    double allocated_bytes; // Per iteration
+  };
+
+  /* One parsed document, or one per NDJSON line */
+  using Documents = std::vector<std::unique_ptr<Json>>;
+
+  size_t CountNodes(const Json& json)
+  {
+    size_t count = 1;
+    json.ForEachChild([&count](const Json& child) {
+      count += CountNodes(child);
+      });
+    return count;
+  }
+
+  size_t CountNodes(const Documents& documents)
+  {
+    size_t count = 0;
+    for (auto& document : documents) count += CountNodes(*document);
+    return count;
+  }
+
+  size_t CorpusBytes(const BenchCorpus::Corpus& corpus)
+  {
+    size_t bytes = corpus.text.size();
+    for (auto& line : corpus.lines) bytes += line.size();
+    return bytes;
+  }
+
+  Documents ParseCorpus(const BenchCorpus::Corpus& corpus)
+  {
+    Documents documents;
+
+    if (corpus.lines.empty())
+    {
+      documents.push_back(Json::Parse(corpus.text));
+    }
+    else
+    {
+      documents.reserve(corpus.lines.size());
+      for (auto& line : corpus.lines) documents.push_back(Json::Parse(line));
+    }
+
+    return documents;
+  }
+
+  // Keeps the optimizer from discarding benchmarked work
+  void DoNotOptimize(const void* ptr)
+  {
+    static std::atomic<const void*> sink;
+    sink.store(ptr, std::memory_order_relaxed);
+  }
+
+  Result Measure(const Options& options, const std::string& corpus, const std::string& operation,
+    size_t bytes, size_t items, const std::function<void()>& body)
+  {
+    // Warm-up run, also touches lazily allocated state
+    body();
+
+    std::vector<double> samples;
+    size_t allocations = 0;
+    size_t allocated_bytes = 0;
+    double total = 0;
+
+    while (samples.size() < 3 || total < options.min_time)
+    {
+      auto count_before = allocation_count.load();
+      auto bytes_before = allocation_bytes.load();
+      auto start = Clock::now();
+
+      body();
+
+      std::chrono::duration<double> elapsed = Clock::now() - start;
+      allocations += allocation_count.load() - count_before;
+      allocated_bytes += allocation_bytes.load() - bytes_before;
+
+      samples.push_back(elapsed.count());
+      total += elapsed.count();
+    }
+
+    std::sort(samples.begin(), samples.end());
+    auto iterations = samples.size();
+
+    return Result{
+      corpus,
+      operation,
+      iterations,
+      samples[iterations / 2],
+      bytes,
+      items,
+      static_cast<double>(allocations) / iterations,
+      static_cast<double>(allocated_bytes) / iterations
+    };
+  }
+
+  void RunCorpus(const Options& options, const BenchCorpus::Corpus& corpus, std::vector<Result>& results)
+  {
+    auto selected = [&options, &corpus](std::string_view operation) {
+      if (options.filter.empty()) return true;
+      auto name = corpus.name + "/" + std::string(operation);
+      return name.find(options.filter) != std::string::npos;
+    };
+
+    auto documents = ParseCorpus(corpus);
+    auto node_count = CountNodes(documents);
+    auto corpus_bytes = CorpusBytes(corpus);
+
+    if (selected("parse"))
+    {
+      results.push_back(Measure(options, corpus.name, "parse", corpus_bytes, node_count, [&corpus]() {
+        auto parsed = ParseCorpus(corpus);
+        DoNotOptimize(parsed.data());
+        }));
+    }
+
+    if (selected("serialize"))
+    {
+      size_t output_bytes = 0;
+      for (auto& document : documents) output_bytes += document->ToString().size();
+
+      results.push_back(Measure(options, corpus.name, "serialize", output_bytes, node_count, [&documents]() {
+        for (auto& document : documents)
+        {
+          auto text = document->ToString();
+          DoNotOptimize(text.data());
+        }
+        }));
+    }
+
+    if (selected("copy"))
+    {
+      results.push_back(Measure(options, corpus.name, "copy", 0, node_count, [&documents]() {
+        for (auto& document : documents)
+        {
+          Json copy(*document);
+          DoNotOptimize(&copy);
+        }
+        }));
+    }
+
+    if (selected("find_all_if"))
+    {
+      // Matches strings only, so packed number/bool arrays are left packed
+      auto is_string = [](const Json& json) { return json.GetType() == Json::ValueType::String; };
+
+      results.push_back(Measure(options, corpus.name, "find_all_if", 0, node_count, [&documents, &is_string]() {
+        for (auto& document : documents)
+        {
+          auto found = document->FindAllIf(is_string);
+          DoNotOptimize(&found);
+        }
+        }));
+    }
+
+    if (selected("lookup_key"))
+    {
+      results.push_back(Measure(options, corpus.name, "lookup_key", 0, corpus.keys.size() * documents.size(),
+        [&documents, &corpus]() {
+          for (auto& document : documents)
+          {
+            for (auto& key : corpus.keys) DoNotOptimize((*document)[key]);
+          }
+        }));
+    }
+
+    // Runs last: operator[](int) unpacks packed arrays into child nodes
+    if (selected("lookup_index"))
+    {
+      std::vector<std::pair<Json*, int>> arrays;
+      size_t lookups = 0;
+
+      for (auto& document : documents)
+      {
+        for (auto& key : corpus.keys)
+        {
+          auto child = (*document)[key];
+          if (child == nullptr || child->GetType() != Json::ValueType::Array) continue;
+
+          int size = 0;
+          child->ForEachChild([&size](const Json&) { size++; });
+          arrays.emplace_back(child, size);
+          lookups += size;
+        }
+      }
+
+      if (arrays.empty()) return;
+
+      results.push_back(Measure(options, corpus.name, "lookup_index", 0, lookups, [&arrays]() {
+        for (auto& [array, size] : arrays)
+        {
+          for (int i = 0; i < size; i++) DoNotOptimize((*array)[i]);
+        }
+        }));
+    }
+  }
+
+  void PrintTable(const std::vector<Result>& results)
+  {
+    std::printf("%-14s %-13s %8s %14s %10s %14s %12s %14s\n",
+      "corpus", "operation", "iters", "median_ms", "MB/s", "items/s", "allocs/iter", "alloc_MB/iter");
+
+    for (auto& result : results)
+    {
+      double mb_per_second = result.bytes / result.median_seconds / 1e6;
+      double items_per_second = result.items / result.median_seconds;
+
+      std::printf("%-14s %-13s %8zu %14.3f %10.1f %14.0f %12.0f %14.2f\n",
+        result.corpus.c_str(), result.operation.c_str(), result.iterations,
+        result.median_seconds * 1e3, mb_per_second, items_per_second,
+        result.allocations, result.allocated_bytes / 1e6);
+    }
+  }
+
+  void PrintCsv(const std::vector<Result>& results)
+  {
+    std::printf("corpus,operation,iterations,median_seconds,bytes,items,mb_per_second,items_per_second,allocations,allocated_bytes\n");
+
+    for (auto& result : results)
+    {
+      std::printf("%s,%s,%zu,%.9f,%zu,%zu,%.3f,%.3f,%.1f,%.1f\n",
+        result.corpus.c_str(), result.operation.c_str(), result.iterations, result.median_seconds,
+        result.bytes, result.items, result.bytes / result.median_seconds / 1e6,
+        result.items / result.median_seconds, result.allocations, result.allocated_bytes);
+    }
+  }
+
+  void PrintJson(const Options& options, const std::vector<Result>& results)
+  {
+    std::printf("{\"scale\":%zu,\"min_time\":%.3f,\"results\":[", options.scale, options.min_time);
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+      auto& result = results[i];
+      std::printf("%s{\"corpus\":\"%s\",\"operation\":\"%s\",\"iterations\":%zu,\"median_seconds\":%.9f,"
+        "\"bytes\":%zu,\"items\":%zu,\"mb_per_second\":%.3f,\"items_per_second\":%.3f,"
+        "\"allocations\":%.1f,\"allocated_bytes\":%.1f}",
+        i == 0 ? "" : ",", result.corpus.c_str(), result.operation.c_str(), result.iterations,
+        result.median_seconds, result.bytes, result.items, result.bytes / result.median_seconds / 1e6,
+        result.items / result.median_seconds, result.allocations, result.allocated_bytes);
+    }
+
+    std::printf("]}\n");
+  }
+
+  bool ParseOptions(int argc, char** argv, Options& options)
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      std::string_view arg = argv[i];
+      bool has_value = i + 1 < argc;
+
+      if (arg == "--format" && has_value)
+      {
+        std::string_view format = argv[++i];
+        if (format == "table") options.format = OutputFormat::Table;
+        else if (format == "csv") options.format = OutputFormat::Csv;
+        else if (format == "json") options.format = OutputFormat::Json;
+        else return false;
+      }
+      else if (arg == "--scale" && has_value)
+      {
+        options.scale = std::max<size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+      }
+      else if (arg == "--min-time" && has_value)
+      {
+        options.min_time = std::strtod(argv[++i], nullptr);
+      }
+      else if (arg == "--filter" && has_value)
+      {
+        options.filter = argv[++i];
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+
+  if (!ParseOptions(argc, argv, options))
+  {
+    std::cerr << "usage: toolkit_bench [--format table|csv|json] [--scale N] [--min-time SECONDS] [--filter TEXT]\n";
+    return 2;
+  }
+
+  std::vector<Result> results;
+
+  for (auto& corpus : BenchCorpus::All(options.scale))
+  {
+    RunCorpus(options, corpus, results);
+  }
+
+  switch (options.format)
+  {
+  case OutputFormat::Csv:   PrintCsv(results); break;
+  case OutputFormat::Json:  PrintJson(options, results); break;
+  default:                  PrintTable(results); break;
+  }
+
+  return 0;
+}
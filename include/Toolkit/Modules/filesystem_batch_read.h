@@ -0,0 +1,62 @@
+#ifndef FILESYSTEM_BATCH_READ_H
+#define FILESYSTEM_BATCH_READ_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Toolkit {
+
+  /*
+   * Reads many whole files at once. On Linux the open, read and close calls of
+   * up to queue_depth files are kept in flight together through io_uring, so
+   * the device queue stays full instead of waiting on one file at a time.
+   * Without io_uring (other platforms, old kernels, sandboxes that forbid it)
+   * the same batch is read by a thread pool.
+   * One Read() at a time per reader.
+   */
+  class FileBatchReader {
+  public:
+    struct Options {
+      size_t queue_depth = 64;
+      size_t thread_count = 0;              // Fallback pool, 0 means one per hardware thread
+      size_t read_size = 64 * 1024;         // First read when the file size is unknown, then doubled
+      bool use_io_uring = true;
+    };
+
+    struct File {
+      std::string data;
+      int error = 0;  // errno of the failed call, 0 on success
+    };
+
+    explicit FileBatchReader(Options options);
+    FileBatchReader();
+
+    /* Results are in the order of paths, buffers are taken from the recycled ones first */
+    std::vector<File> Read(const std::vector<std::string>& paths);
+
+    /* Caller-provided buffers: reads up to buffers[i].size() bytes of paths[i] and stores
+       the byte count, or -errno, in sizes[i] */
+    void Read(const std::vector<std::string>& paths, std::span<const std::span<char>> buffers, std::span<int64_t> sizes);
+
+    /* Keeps the buffers of files for the next Read() */
+    void Recycle(std::vector<File>&& files);
+
+    /* Whether the last Read() went through io_uring */
+    bool UsedIoUring() const;
+
+  private:
+    struct Job;
+
+    void Run(std::vector<Job>& jobs);
+    bool RunIoUring(std::vector<Job>& jobs);
+    void RunThreads(std::vector<Job>& jobs);
+
+    Options options_;
+    bool used_io_uring_;
+    std::vector<std::string> buffer_pool_;
+  };
+}
+
+#endif // !FILESYSTEM_BATCH_READ_H
@@ -0,0 +1,71 @@
+#ifndef FILESYSTEM_COPY_H
+#define FILESYSTEM_COPY_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace Toolkit {
+
+  struct CopyProgress {
+    uint64_t bytes_copied = 0;
+    uint64_t bytes_total = 0;
+    size_t files_copied = 0;  // Skipped and failed files count as done
+    size_t files_total = 0;
+  };
+
+  struct CopyOptions {
+    enum class Existing {
+      Fail,       // Reported as a failure, the destination is left alone
+      Skip,
+      Overwrite,
+    };
+
+    Existing existing = Existing::Fail;
+    bool preserve_metadata = true;  // Permissions, timestamps, and owner when permitted
+    bool reflink = true;            // Share extents instead of copying them where the filesystem can
+    size_t thread_count = 0;        // 0 means one per hardware thread
+
+    /* Called from the copying threads as data is written, calls are serialized */
+    std::function<void(const CopyProgress&)> progress;
+  };
+
+  struct CopyFailure {
+    std::string path;  // Source path
+    std::error_code error;
+  };
+
+  struct CopyResult {
+    CopyProgress progress;
+    std::vector<CopyFailure> failures;
+
+    bool Succeeded() const;
+  };
+
+  /*
+   * File and directory tree copies that leave the data movement to the kernel.
+   * On Linux a file is first cloned (FICLONE), then copied with copy_file_range,
+   * sendfile and at last read/write, whichever the two filesystems allow.
+   * Files of a tree are copied in parallel on WorkStealingPool. Hard links are
+   * copied as separate files, other special files are reported as failures.
+   */
+  class FileCopier {
+  public:
+    explicit FileCopier(CopyOptions options = {});
+
+    /* Copies the file, symlink or directory from to the path to, not into it.
+       Directories that already exist are merged. */
+    CopyResult Copy(const std::string& from, const std::string& to);
+
+    /* Renames from to to, or copies and then removes from when they are on different
+       filesystems. The progress only counts what had to be copied. */
+    CopyResult Move(const std::string& from, const std::string& to);
+
+  private:
+    CopyOptions options_;
+  };
+}
+
+#endif // !FILESYSTEM_COPY_H
@@ -0,0 +1,77 @@
+#ifndef FILESYSTEM_EX_H
+#define FILESYSTEM_EX_H
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <memory>
+
+#include "filesystem_listing.h"
+#include "filesystem_usage.h"
+#include "filesystem_walk.h"
+
+namespace Toolkit {
+
+  class DirectoryCache;
+
+  class Filesystem {
+    using StrList = std::vector<std::string>;
+
+  public:
+
+    struct Entries {
+      StrList dirs;
+      StrList files;
+    };
+
+    Filesystem();
+    Filesystem(const std::string& path_str);
+
+    void LeaveDir();
+    bool VisitDir(const std::string& dir_name);
+    std::string GetCurrentPath() const;
+
+    StrList GetDirs();
+    StrList GetFiles();
+
+    /* Files of the current directory whose name matches pattern */
+    StrList GetFiles(const PathPattern& pattern);
+    Entries GetEntries();
+
+    /* Opens the current directory in listing, which can be reused across calls */
+    bool List(DirectoryListing& listing) const;
+
+    void SetPath(const std::string& path_str);
+
+    /* Serve GetDirs/GetFiles/GetEntries from a shared cache, nullptr reads from disk */
+    void SetCache(std::shared_ptr<DirectoryCache> cache);
+
+    static bool PathExists(const std::string& path_str);
+
+    /* Recursive listing of root spread over a work-stealing thread pool, entries arrive
+       in no particular order. Unreadable directories are skipped and passed to
+       options.on_error. Returns false when root is not a directory or the
+       consumer stopped the walk. */
+    static bool Walk(const std::string& root, const WalkOptions& options, const WalkConsumer& consumer);
+
+    /* Sizes and block counts of every directory below root, rolled up the tree.
+       Directories are listed and their entries stat'ed in parallel. */
+    static DiskUsageReport DiskUsage(const std::string& root, const DiskUsageOptions& options = {});
+
+  private:
+
+    struct WalkState;
+    static void WalkDirectory(WalkState& state, const std::string& dir, uint32_t depth);
+    static void FlushWalkBatch(WalkState& state, std::vector<WalkEntry>& batch);
+    static void ReportWalkError(WalkState& state, const std::string& dir, std::error_code error);
+
+    static std::string PathToUtf8(const std::filesystem::path& path);
+    static std::filesystem::path Utf8ToPath(const std::string& path);
+
+    std::filesystem::path path_;
+    std::shared_ptr<DirectoryCache> cache_;
+  };
+}
+
+
+#endif // !FILESYSTEM_EX_H
@@ -0,0 +1,63 @@
+#ifndef FILESYSTEM_HASH_H
+#define FILESYSTEM_HASH_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Toolkit {
+
+  struct FileHashOptions {
+    enum class Algorithm {
+      Fast,    // 64-bit wyhash-style, for change detection and dedup candidates
+      Sha256,
+    };
+
+    Algorithm algorithm = Algorithm::Fast;
+    size_t thread_count = 0;          // 0 means one per hardware thread
+    size_t block_size = 1024 * 1024;  // Read size rounded up to 64 KiB, each worker owns one buffer
+    bool include_empty = false;       // FindDuplicates reports zero-length files as one group
+  };
+
+  struct FileDigest {
+    std::string path;
+    uint64_t size = 0;
+    bool valid = false;  // false when the file could not be read
+    std::array<uint8_t, 32> digest{};
+    size_t digest_size = 0;
+
+    std::string ToHex() const;
+    bool operator==(const FileDigest& other) const;  // Same content, paths are not compared
+  };
+
+  /* Files with identical content */
+  struct DuplicateGroup {
+    uint64_t size = 0;
+    std::vector<std::string> paths;
+  };
+
+  /*
+   * Parallel file content hashing on WorkStealingPool.
+   * FindDuplicates only reads files that share their size with another one,
+   * and hashes a short prefix first so that most of them are never read in full.
+   */
+  class FileHasher {
+  public:
+    explicit FileHasher(FileHashOptions options = {});
+
+    /* Results are in the order of paths */
+    std::vector<FileDigest> Hash(const std::vector<std::string>& paths);
+
+    /* Groups of two or more files, largest files first */
+    std::vector<DuplicateGroup> FindDuplicates(const std::vector<std::string>& paths);
+
+    /* All regular files below root */
+    std::vector<DuplicateGroup> FindDuplicates(const std::string& root);
+
+  private:
+    FileHashOptions options_;
+  };
+}
+
+#endif // !FILESYSTEM_HASH_H
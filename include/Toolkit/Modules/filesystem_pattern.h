@@ -0,0 +1,71 @@
+#ifndef FILESYSTEM_PATTERN_H
+#define FILESYSTEM_PATTERN_H
+
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Toolkit {
+
+  /*
+   * Compiled path filter matched against '/' separated paths relative to the
+   * directory being searched.
+   * Glob syntax: '?' and '*' within one component, "**" as a whole component
+   * for any number of directories, [a-z] / [!a-z] classes, {a,b} alternatives
+   * (may nest) and '\' to escape. A glob also tells whether anything below a
+   * directory can match, so Filesystem::Walk() does not enter the others.
+   * Regex patterns (ECMAScript, whole path) cannot prune. Globs have at most 63 components.
+   * A default constructed pattern matches everything.
+   */
+  class PathPattern {
+  public:
+    PathPattern() = default;
+
+    /* Invalid syntax gives a pattern for which IsValid() is false and that matches nothing */
+    static PathPattern Glob(std::string_view pattern);
+    static PathPattern Regex(const std::string& pattern);
+
+    bool IsValid() const;
+    bool IsEmpty() const;
+
+    bool Matches(std::string_view path) const;
+
+    /* false when no path below directory can match */
+    bool CanMatchBelow(std::string_view directory) const;
+
+  private:
+    struct Token {
+      enum class Kind : int8_t {
+        Literal,
+        AnyChar,
+        AnySequence,
+        Class,
+      };
+
+      Kind kind;
+      char literal;
+      std::bitset<256> set;
+    };
+
+    struct Segment {
+      bool globstar = false;
+      std::vector<Token> tokens;
+    };
+
+    using Alternative = std::vector<Segment>;
+
+    static bool ParseSegment(std::string_view text, Segment& segment);
+    static bool MatchSegment(const Segment& segment, std::string_view name);
+    static uint64_t Simulate(const Alternative& alternative, std::string_view path);
+
+    bool valid_ = true;
+    std::vector<Alternative> alternatives_;
+    std::shared_ptr<const std::regex> regex_;
+  };
+}
+
+#endif // !FILESYSTEM_PATTERN_H
@@ -0,0 +1,67 @@
+#ifndef FILESYSTEM_POOL_H
+#define FILESYSTEM_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Toolkit {
+
+  /*
+   * Thread pool for filesystem work that spawns more work (e.g. one task per directory).
+   * Every worker has its own deque: tasks submitted by a worker go to the back of
+   * its deque and are taken from there, idle workers steal from the front of the
+   * others, so a deep tree is shared out breadth-first while each worker runs depth-first.
+   */
+  class WorkStealingPool {
+  public:
+    using Task = std::function<void()>;
+
+    /* 0 threads means std::thread::hardware_concurrency() */
+    explicit WorkStealingPool(size_t thread_count = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void Submit(Task task);
+
+    /* Blocks until every submitted task, including the ones they submitted, has finished.
+       Rethrows the first exception thrown by a task. Must not be called from a task. */
+    void Wait();
+
+    size_t GetThreadCount() const;
+
+    /* Index of the calling worker of this pool, or GetThreadCount() outside of it */
+    size_t GetWorkerIndex() const;
+
+  private:
+    struct Queue {
+      std::mutex mutex;
+      std::deque<Task> tasks;
+    };
+
+    void Run(std::stop_token stop_token, size_t index);
+    bool TakeTask(size_t index, Task& task);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::atomic<size_t> queued_;
+    std::atomic<size_t> pending_;
+    std::atomic<size_t> next_queue_;
+
+    std::mutex mutex_;
+    std::condition_variable_any wake_;
+    std::condition_variable_any done_;
+    std::exception_ptr error_;
+
+    std::vector<std::jthread> threads_;
+  };
+}
+
+#endif // !FILESYSTEM_POOL_H
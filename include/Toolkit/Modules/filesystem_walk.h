@@ -0,0 +1,56 @@
+#ifndef FILESYSTEM_WALK_H
+#define FILESYSTEM_WALK_H
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "filesystem_listing.h"
+#include "filesystem_pattern.h"
+
+namespace Toolkit {
+
+  /* Entry found by Filesystem::Walk() */
+  struct WalkEntry {
+    using Type = EntryType;
+
+    std::string path;  // Generic UTF-8 path starting with the walk root
+    Type type;
+    uint32_t depth;    // 1 for entries directly in the root
+
+    std::string_view GetName() const;
+  };
+
+  /* Receives entries in batches, calls are serialized. Return false to stop the walk. */
+  using WalkConsumer = std::function<bool(std::span<const WalkEntry>)>;
+
+  struct WalkOptions {
+    enum class Symlinks {
+      Report,  // Reported as WalkEntry::Type::Symlink
+      Follow,  // Reported as their target, a directory reached through links is entered once
+      Skip,
+    };
+
+    size_t max_depth = std::numeric_limits<size_t>::max();
+    Symlinks symlinks = Symlinks::Report;
+
+    /* Called for every directory before it is entered, return true to skip its contents */
+    std::function<bool(const WalkEntry&)> prune;
+
+    /* Called for every directory that could not be listed in full, calls are serialized */
+    std::function<void(const std::string& path, std::error_code error)> on_error;
+
+    /* Only entries whose path relative to root matches are reported, and only
+       directories that can contain a match are entered */
+    PathPattern pattern;
+
+    size_t thread_count = 0;  // 0 means one per hardware thread
+    size_t batch_size = 1024;
+  };
+}
+
+#endif // !FILESYSTEM_WALK_H
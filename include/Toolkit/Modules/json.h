@@ -0,0 +1,464 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+#include <vector>
+#include <concepts>
+#include <memory>
+#include <variant>
+#include <any>
+#include <functional>
+#include <utility>
+#include <type_traits>
+#include <list>
+#include <span>
+#include <ranges>
+#include <atomic>
+
+#include "json_allocator.h"
+#include "json_string.h"
+#include "json_packed_array.h"
+
+class Json;
+
+template<typename T, typename... U>
+concept any_of = std::disjunction_v<std::is_same<T, U>...>;
+
+template<typename T>
+concept Arithmetic = std::is_arithmetic_v<std::remove_cvref_t<T>>;
+
+using ChildrenList = std::vector<std::unique_ptr<Json>, JsonStdAllocator<std::unique_ptr<Json>>>;
+using Bool = bool;
+using Number = double;
+using String = std::string;
+using Array = ChildrenList;
+
+/* Read-only view of a node's value, Null and Undefined nodes hold std::monostate */
+using JsonValue = std::variant<std::monostate, std::string_view, Number, Bool, const ChildrenList*, const JsonPackedArray*>;
+
+/* Immutable, reference-counted document, see Json::Freeze() */
+using FrozenJson = std::shared_ptr<const Json>;
+
+using ProgresCallback = std::function<bool(size_t)>;
+
+template<class T>
+concept StringLike = std::is_convertible_v<T, std::string_view>;
+
+template<class T>
+concept Predicate = requires(T predicate, const Json & a)
+{
+  { predicate(a) } -> std::same_as<bool>;
+};
+
+
+
+class Json {
+public:
+
+  enum class ValueType : int8_t {
+    Undefined = -1,
+    String,
+    Number,
+    Bool,
+    Object,
+    Array,
+    Null,
+  };
+
+  /* Bytes used by a subtree, see MemoryFootprint() */
+  struct Footprint {
+    size_t node_count = 0;
+    size_t nodes = 0;          // sizeof(Json) per node
+    size_t keys = 0;           // Keys too long to be stored inline
+    size_t strings = 0;        // String values too long to be stored inline
+    size_t children = 0;       // Children list capacity
+    size_t packed_arrays = 0;  // Packed array objects and their buffers
+
+    size_t Total() const;
+  };
+
+  /* How MergeFrom combines two nodes of the same container type */
+  struct MergePolicy {
+    enum class Objects {
+      Recurse,    // Merge members key by key
+      Overwrite,  // Replace the whole object
+    };
+
+    enum class Arrays {
+      Replace,
+      Append,
+    };
+
+    Objects objects = Objects::Recurse;
+    Arrays arrays = Arrays::Replace;
+    bool null_deletes = false;  // A null member removes the key (JSON merge patch)
+  };
+
+  Json();
+  Json(std::string_view key, Json* parent);
+  Json(const Json& obj);
+  Json(Json&& obj) noexcept;
+  Json& operator=(const Json& obj);
+  Json& operator=(Json&& obj) noexcept;
+  ~Json();
+
+  /* Nodes are allocated through JsonAllocator::AllocateOwned() */
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr, size_t size);
+
+  /* Accessors and mutators */
+  Json::ValueType GetType() const;
+  std::string_view GetKey() const;
+  Json* GetParent() const;
+  JsonValue GetValue() const;
+
+  bool SetKey(std::string name);
+  void SetParent(Json* parent);
+
+  template<StringLike T>
+  void SetValue(T&& data);
+
+  template<Arithmetic T>
+  void SetValue(T&& data);
+
+  void SetValue(bool data);
+  void ClearValue();
+  std::unique_ptr<Json> Detach();
+  bool RemoveChild(int index);
+
+  /* Merges other into this node, moving its nodes and strings instead of copying them.
+     Anything that is not merged recursively replaces the current value; other is left Undefined. */
+  Json& MergeFrom(Json&& other);
+  Json& MergeFrom(Json&& other, const MergePolicy& policy);
+
+  /* Batch removal - one stable compaction pass over the children */
+  template<Predicate T>
+  size_t RemoveChildrenIf(const T& predicate);
+  size_t RemoveChildren(std::span<const int> indices);
+
+  /* Batch detach - returned subtrees are roots, in their original order */
+  template<Predicate T>
+  ChildrenList DetachChildrenIf(const T& predicate);
+  ChildrenList DetachChildren(std::span<Json* const> nodes);
+
+  bool IsValid() const;
+  bool IsRoot() const;
+  bool IsArrayElement() const;
+  bool IsLastChild() const;
+  Json* GetRoot();
+
+  Json* operator[](std::string_view key);
+  Json* operator[](int index);
+
+  /* Read-only lookups, never unpack - packed array elements are only reachable
+     through the GetNumbers/GetIntegers/GetBools spans and ForEachChild */
+  const Json* operator[](std::string_view key) const;
+  const Json* operator[](int index) const;
+
+  /* Object maniputaion methods */
+  /* - Add child elements */
+  template<typename T>
+  Json* AddChild(T&& data, std::string_view key);
+
+  template<typename T>
+  Json* AddValue(T&& data);
+
+  /* - Append arithmetic values into a packed array buffer */
+  template<std::ranges::input_range R>
+    requires Arithmetic<std::ranges::range_value_t<R>>
+  void AddValues(const R& values);
+
+  /* Packed array elements are handed out as a temporary node without a parent, valid
+     during the call. It counts as an array element, the index overload gives its position. */
+  void ForEachChild(const std::function<void(const Json&)>& function) const;
+  void ForEachChild(const std::function<void(const Json&, size_t index)>& function) const;
+
+  /* Packed arrays */
+  /* Homogeneous number/bool arrays may be stored contiguously instead of as child nodes.
+     operator[](int), AddValue and RemoveChild unpack them back into nodes. */
+  bool IsPacked() const;
+  bool Pack();
+  void Unpack();
+  std::span<const Number> GetNumbers() const;
+  std::span<const int64_t> GetIntegers() const;
+  std::span<const uint8_t> GetBools() const;
+
+  /* Json conversion to string */
+  std::string ToString() const;
+
+  /* Memory introspection */
+  Footprint MemoryFootprint() const;
+
+  /* Order-aware content hash of the subtree, the node's own key is not included.
+     Memoized per node and cleared along the parent chain when the subtree changes,
+     safe to call concurrently on a frozen document. */
+  uint64_t Hash() const;
+
+  /* Immutable snapshots - const access to a frozen document is safe from any number of threads */
+  FrozenJson Freeze() const;
+  static FrozenJson Freeze(std::unique_ptr<Json> json);
+
+  /* Frozen document where identical subtrees (same key, value and parent type) are
+     stored once and referenced from every occurrence, and repeated long strings
+     share one buffer. Accessors work as usual, but GetParent() of a shared
+     subtree leads to its first occurrence and MemoryFootprint() counts every occurrence. */
+  static FrozenJson FreezeDeduplicated(std::unique_ptr<Json> json);
+  static FrozenJson ParseDeduplicated(const std::string& data);
+
+  /* Searching methods */
+  template<Predicate T>
+  Json* FindIf(const T& predicate);
+
+  template<Predicate T>
+  std::list<Json*> FindAllIf(const T& predicate)
+  {
+    std::list<Json*> list;
+
+    auto result = predicate(*this);
+    if (result) list.push_back(this);
+
+    std::list<Json*> children_list;
+
+    if (IsPacked() && AnyPackedElement(predicate)) Unpack();
+
+    if (IsContainer())
+    {
+      for (auto& element : children_)
+      {
+        children_list.splice(children_list.end(), element->FindAllIf(predicate));
+      }
+    }
+
+    children_list.splice(children_list.end(), list);
+
+    return children_list;
+  }
+
+  /* Parsing methods */
+  static std::unique_ptr<Json> Parse(const std::string& data, const ProgresCallback = ProgresCallback());
+
+private:
+
+  /* Accessors and mutators */
+  void SetType(ValueType type);
+  void ConvertToArray();
+  bool IsContainer() const;
+  void StartPacked(JsonPackedArray::ElementType type);
+  size_t CompactChildren(std::span<const uint8_t> remove_mask, ChildrenList* detached);
+  void MergeObject(Json& other, const MergePolicy& policy);
+  void AppendArray(Json& other);
+  void TakeValue(Json& other);
+  void InvalidateHash();
+  uint64_t ComputeHash() const;
+
+  struct DeduplicationState;
+  void Deduplicate(DeduplicationState& state);
+  void ShareStrings(DeduplicationState& state);
+  bool Equals(const Json& other) const;
+
+  template<Predicate T>
+  bool AnyPackedElement(const T& predicate) const;
+
+  /* Value storage management, the active union member follows value_type_ */
+  void ConstructValue();
+  void DestroyValue();
+  void CopyValueFrom(const Json& obj);
+  void MoveValueFrom(Json& obj);
+
+  /* Json conversion to string */
+  void ToString(std::string& str) const;
+
+  void MemoryFootprint(Footprint& footprint) const;
+  void ShrinkToFit();
+
+  template<typename F>
+  void VisitChildren(const F& function) const;
+
+  Json* parent_;
+  JsonString key_;
+
+  //Values
+  union {
+    JsonString string_;
+    Number number_;
+    Bool bool_;
+    ChildrenList children_;
+    std::unique_ptr<JsonPackedArray> packed_;
+  };
+  ValueType value_type_;
+  bool is_packed_;
+
+  // Number written as an integer, in the text or as a C++ integral type, see Pack()
+  bool is_integer_;
+
+  // Temporary element of a packed array handed out by ForEachChild. It has no parent,
+  // so hashing or setting it never reaches the array, and knows whether it is the last.
+  enum class ElementView : int8_t { None, Element, Last };
+  ElementView element_view_;
+
+  // Memoized Hash(), 0 when stale. A stale node never has a valid ancestor.
+  mutable std::atomic<uint64_t> hash_;
+
+  friend class JsonParser;
+  friend class JsonBuilder;
+};
+
+
+template<StringLike T>
+void Json::SetValue(T&& data) {
+  SetType(ValueType::String);
+  string_.Assign(std::string_view(data));
+}
+
+template<Arithmetic T>
+void Json::SetValue(T&& data) {
+  if (std::is_same_v<std::remove_cvref_t<T>, bool>)
+  {
+    SetType(ValueType::Bool);
+    bool_ = static_cast<bool>(std::forward<T>(data));
+  }
+  else {
+    using Value = std::remove_cvref_t<T>;
+
+    SetType(ValueType::Number);
+    number_ = static_cast<double>(data);
+
+    if constexpr (std::is_unsigned_v<Value> && sizeof(Value) >= sizeof(int64_t)) is_integer_ = data <= static_cast<Value>(INT64_MAX);
+    else is_integer_ = std::is_integral_v<Value>;
+  }
+}
+
+
+template<typename T>
+Json* Json::AddChild(T&& data, std::string_view key)
+{
+  if (value_type_ != ValueType::Object && value_type_ != ValueType::Null) return nullptr;
+
+  if (value_type_ == ValueType::Null) SetType(ValueType::Object);
+
+  InvalidateHash();
+  children_.push_back(std::make_unique<Json>());
+
+  auto& newObj = *children_.back();
+
+  newObj.parent_ = this;
+  newObj.key_.Assign(key);
+  
+  newObj.SetValue(std::forward<T>(data));
+
+  return &newObj;
+}
+
+template<typename T>
+Json* Json::AddValue(T&& data)
+{
+  if (value_type_ == ValueType::Null) SetType(ValueType::Array);
+
+  if (value_type_ != ValueType::Array) ConvertToArray();
+  if (is_packed_) Unpack();
+
+  InvalidateHash();
+  children_.push_back(std::make_unique<Json>());
+  children_.back()->SetValue(std::forward<T>(data));
+  children_.back()->SetParent(this);
+
+  return children_.back().get();
+}
+
+template<std::ranges::input_range R>
+  requires Arithmetic<std::ranges::range_value_t<R>>
+void Json::AddValues(const R& values)
+{
+  using ElementType = JsonPackedArray::ElementType;
+  using Value = std::ranges::range_value_t<R>;
+  constexpr bool is_bool = std::is_same_v<Value, bool>;
+  constexpr bool is_integer = std::is_integral_v<Value> && !is_bool
+    && (std::is_signed_v<Value> || sizeof(Value) < sizeof(int64_t));
+
+  if (value_type_ == ValueType::Null) SetType(ValueType::Array);
+
+  bool packable = value_type_ == ValueType::Array
+    && (is_packed_ ? packed_->IsNumeric() != is_bool : children_.empty());
+
+  if (!packable)
+  {
+    for (auto&& value : values) AddValue(value);
+    return;
+  }
+
+  if (!is_packed_) StartPacked(is_bool ? ElementType::Bool
+    : is_integer ? ElementType::Integer : ElementType::Number);
+
+  InvalidateHash();
+
+  if constexpr (std::ranges::sized_range<R>)
+  {
+    packed_->Reserve(packed_->Size() + std::ranges::size(values));
+  }
+
+  for (auto&& value : values)
+  {
+    if constexpr (is_bool) packed_->AppendBool(value);
+    else if constexpr (is_integer) packed_->AppendInteger(static_cast<int64_t>(value));
+    else packed_->AppendNumber(static_cast<double>(value));
+  }
+}
+
+template<Predicate T>
+size_t Json::RemoveChildrenIf(const T& predicate)
+{
+  std::vector<uint8_t> remove_mask;
+  ForEachChild([&remove_mask, &predicate](const Json& child) {
+    remove_mask.push_back(predicate(child) ? 1 : 0);
+    });
+
+  return CompactChildren(remove_mask, nullptr);
+}
+
+template<Predicate T>
+ChildrenList Json::DetachChildrenIf(const T& predicate)
+{
+  std::vector<uint8_t> remove_mask;
+  ForEachChild([&remove_mask, &predicate](const Json& child) {
+    remove_mask.push_back(predicate(child) ? 1 : 0);
+    });
+
+  ChildrenList detached;
+  CompactChildren(remove_mask, &detached);
+  return detached;
+}
+
+template<Predicate T>
+bool Json::AnyPackedElement(const T& predicate) const
+{
+  bool matched = false;
+  ForEachChild([&matched, &predicate](const Json& element) {
+    matched = matched || predicate(element);
+    });
+  return matched;
+}
+
+template<Predicate T>
+Json* Json::FindIf(const T& predicate) {
+  Json* found = nullptr;
+  auto result = predicate(*this);
+  if (!result) {
+
+    if (IsPacked() && AnyPackedElement(predicate)) Unpack();
+
+    if (IsContainer())
+    {
+      for (auto& element : children_)
+      {
+        found = element->FindIf(predicate);
+      }
+    }
+
+  }
+  else {
+    found = this;
+  }
+  return found;
+}
+
+#endif // !JSON_H
@@ -0,0 +1,151 @@
+#ifndef JSON_ALLOCATOR_H
+#define JSON_ALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/*
+ * Allocation hook used for Json nodes, heap strings, children lists and
+ * packed array buffers. The hook is selected per thread with JsonAllocatorScope.
+ *
+ * Every block records its owner (see AllocateOwned()) and goes back to it when
+ * released, even if a different allocator is installed by then (a tree usually
+ * outlives the scope that built it). An allocator must therefore outlive the
+ * memory it hands out, and be thread safe if trees are released on other threads.
+ */
+class JsonAllocator {
+public:
+  virtual ~JsonAllocator() = default;
+
+  virtual void* Allocate(size_t size, size_t alignment) = 0;
+  virtual void Deallocate(void* ptr, size_t size, size_t alignment) = 0;
+
+  /* Allocator that releases the blocks handed out by this one */
+  virtual JsonAllocator& GetOwner();
+
+  /* Allocates from Current() with a header naming its owner in front of the block */
+  static void* AllocateOwned(size_t size, size_t alignment);
+
+  /* Releases a block from AllocateOwned() to its owner, or to Current() if that
+     allocator is installed over the owner (e.g. a pool caching the owner's blocks) */
+  static void DeallocateOwned(void* ptr, size_t size, size_t alignment);
+
+  /* Size of an AllocateOwned() request as seen by the allocator */
+  static constexpr size_t GetOwnedSize(size_t size, size_t alignment)
+  {
+    return size + GetHeaderSize(alignment);
+  }
+
+  /* Allocator installed on the calling thread */
+  static JsonAllocator& Current();
+
+  /* ::operator new / ::operator delete */
+  static JsonAllocator& Default();
+
+private:
+  static constexpr size_t GetHeaderSize(size_t alignment)
+  {
+    return alignment > sizeof(JsonAllocator*) ? alignment : sizeof(JsonAllocator*);
+  }
+
+  static JsonAllocator*& CurrentSlot();
+
+  friend class JsonAllocatorScope;
+};
+
+struct JsonAllocationStats {
+  size_t allocations = 0;
+  size_t deallocations = 0;
+  size_t allocated_bytes = 0;
+  size_t live_bytes = 0;
+  size_t peak_bytes = 0;
+};
+
+/* Forwards to an upstream allocator and records counters */
+class JsonCountingAllocator : public JsonAllocator {
+public:
+  explicit JsonCountingAllocator(JsonAllocator& upstream = JsonAllocator::Current());
+
+  void* Allocate(size_t size, size_t alignment) override;
+  void Deallocate(void* ptr, size_t size, size_t alignment) override;
+
+  const JsonAllocationStats& GetStats() const;
+  void ResetStats();
+
+private:
+  JsonAllocator& upstream_;
+  JsonAllocationStats stats_;
+};
+
+/*
+ * Free list for blocks of one size (e.g. GetOwnedSize() of a Json), other requests
+ * go upstream. The pool only caches blocks of its upstream, which stays their owner.
+ */
+class JsonPoolAllocator : public JsonAllocator {
+public:
+  JsonPoolAllocator(size_t block_size, size_t max_blocks, JsonAllocator& upstream = JsonAllocator::Default());
+  ~JsonPoolAllocator() override;
+
+  JsonPoolAllocator(const JsonPoolAllocator&) = delete;
+  JsonPoolAllocator& operator=(const JsonPoolAllocator&) = delete;
+
+  void* Allocate(size_t size, size_t alignment) override;
+  void Deallocate(void* ptr, size_t size, size_t alignment) override;
+  JsonAllocator& GetOwner() override;
+
+  /* Releases the cached blocks of the previous upstream */
+  void SetUpstream(JsonAllocator& upstream);
+  size_t GetCachedBlocks() const;
+
+  /* Returns all cached blocks to the upstream allocator */
+  void Release();
+
+private:
+  bool IsPooled(size_t size, size_t alignment) const;
+
+  size_t block_size_;
+  size_t max_blocks_;
+  JsonAllocator* upstream_;
+  std::vector<void*> free_blocks_;
+};
+
+/* Installs an allocator on the calling thread for the lifetime of the scope */
+class JsonAllocatorScope {
+public:
+  explicit JsonAllocatorScope(JsonAllocator& allocator);
+  ~JsonAllocatorScope();
+
+  JsonAllocatorScope(const JsonAllocatorScope&) = delete;
+  JsonAllocatorScope& operator=(const JsonAllocatorScope&) = delete;
+
+private:
+  JsonAllocator* previous_;
+};
+
+/* Standard library allocator adapter over JsonAllocator::AllocateOwned() */
+template<typename T>
+class JsonStdAllocator {
+public:
+  using value_type = T;
+
+  JsonStdAllocator() noexcept = default;
+
+  template<typename U>
+  JsonStdAllocator(const JsonStdAllocator<U>&) noexcept {}
+
+  T* allocate(size_t count)
+  {
+    return static_cast<T*>(JsonAllocator::AllocateOwned(count * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* ptr, size_t count) noexcept
+  {
+    JsonAllocator::DeallocateOwned(ptr, count * sizeof(T), alignof(T));
+  }
+
+  template<typename U>
+  bool operator==(const JsonStdAllocator<U>&) const noexcept { return true; }
+};
+
+#endif // !JSON_ALLOCATOR_H
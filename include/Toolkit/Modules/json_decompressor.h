@@ -0,0 +1,67 @@
+#ifndef JSON_DECOMPRESSOR_H
+#define JSON_DECOMPRESSOR_H
+
+#include <memory>
+
+#include "json_stream.h"
+
+/*
+ * Chunk reader that inflates gzip/zlib or zstd input as it is read, so
+ * compressed files can be fed to JsonParser::ParseElements() without an
+ * uncompressed copy in memory. Format::Auto detects the format from the
+ * magic bytes and passes anything else through unchanged.
+ *
+ * Codecs are optional at build time (zlib, libzstd), see IsSupported().
+ * An unsupported format or corrupt input ends the stream early and sets Failed().
+ */
+class JsonDecompressor {
+public:
+  enum class Format {
+    Auto,
+    Plain,
+    Gzip,   // gzip or zlib wrapped deflate
+    Zstd,
+  };
+
+  explicit JsonDecompressor(JsonChunkReader compressed, Format format = Format::Auto,
+    size_t chunk_size = JsonStreamCursor::kDefaultChunkSize);
+  ~JsonDecompressor();
+
+  JsonDecompressor(const JsonDecompressor&) = delete;
+  JsonDecompressor& operator=(const JsonDecompressor&) = delete;
+
+  static bool IsSupported(Format format);
+
+  /* JsonChunkReader interface, 0 at the end of the stream */
+  size_t Read(char* buffer, size_t size);
+
+  /* Reader bound to this object, which must outlive it */
+  JsonChunkReader GetReader();
+
+  Format GetFormat() const;
+  bool Failed() const;
+
+private:
+  struct State;
+
+  bool Refill();
+  void DetectFormat();
+  size_t ReadPlain(char* buffer, size_t size);
+  size_t ReadGzip(char* buffer, size_t size);
+  size_t ReadZstd(char* buffer, size_t size);
+
+  JsonChunkReader source_;
+  Format format_;
+  bool failed_;
+  bool source_finished_;
+  bool frame_finished_;
+
+  std::unique_ptr<char[]> input_;
+  size_t input_capacity_;
+  size_t input_pos_;
+  size_t input_size_;
+
+  std::unique_ptr<State> state_;
+};
+
+#endif // !JSON_DECOMPRESSOR_H
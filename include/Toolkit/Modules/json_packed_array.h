@@ -0,0 +1,63 @@
+#ifndef JSON_PACKED_ARRAY_H
+#define JSON_PACKED_ARRAY_H
+
+#include <vector>
+#include <span>
+#include <cstdint>
+
+#include "json_allocator.h"
+
+/*
+ * Contiguous storage for homogeneous arrays of numbers or booleans.
+ * Integral numbers are kept as int64_t until the first fractional value
+ * is appended, then the whole buffer is promoted to double.
+ * Booleans are stored one per byte (0 or 1).
+ */
+class JsonPackedArray {
+public:
+  enum class ElementType : int8_t {
+    Number,
+    Integer,
+    Bool,
+  };
+
+  explicit JsonPackedArray(ElementType type);
+
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr, size_t size);
+
+  ElementType GetElementType() const;
+  size_t Size() const;
+  bool Empty() const;
+  bool IsNumeric() const;
+  void Reserve(size_t size);
+  void ShrinkToFit();
+
+  /* Append returns false when the value does not match the element type */
+  bool AppendNumber(double value);
+  bool AppendInteger(int64_t value);
+  bool AppendBool(bool value);
+
+  /* Stable in-place removal of the elements flagged in remove_mask, returns the removed count */
+  size_t Compact(std::span<const uint8_t> remove_mask);
+
+  double NumberAt(size_t index) const;
+  bool BoolAt(size_t index) const;
+
+  std::span<const double> GetNumbers() const;
+  std::span<const int64_t> GetIntegers() const;
+  std::span<const uint8_t> GetBools() const;
+
+  /* Bytes held by the object and its buffers */
+  size_t HeapBytes() const;
+
+private:
+  void PromoteToNumbers();
+
+  ElementType element_type_;
+  std::vector<double, JsonStdAllocator<double>> numbers_;
+  std::vector<int64_t, JsonStdAllocator<int64_t>> integers_;
+  std::vector<uint8_t, JsonStdAllocator<uint8_t>> bools_;
+};
+
+#endif // !JSON_PACKED_ARRAY_H
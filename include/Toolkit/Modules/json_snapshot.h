@@ -0,0 +1,55 @@
+#ifndef JSON_SNAPSHOT_H
+#define JSON_SNAPSHOT_H
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+#include "json.h"
+
+/*
+ * RCU-style holder of a frozen document.
+ *
+ * Writers build a new tree, freeze it and Publish() it. Readers keep a
+ * JsonSnapshot::Reader per thread: Get() only loads the version counter while
+ * nothing changes, so steady-state reads take no lock and write no shared
+ * cache line. An old version is released when its last reader moves on.
+ */
+class JsonSnapshot {
+public:
+  class Reader {
+  public:
+    explicit Reader(const JsonSnapshot& snapshot);
+
+    /* Current document, valid until the next Get() on this reader */
+    const Json* Get();
+    const FrozenJson& GetShared();
+    uint64_t GetVersion() const;
+
+  private:
+    void Refresh();
+
+    const JsonSnapshot& snapshot_;
+    FrozenJson cached_;
+    uint64_t cached_version_;
+  };
+
+  JsonSnapshot();
+  explicit JsonSnapshot(FrozenJson json);
+
+  JsonSnapshot(const JsonSnapshot&) = delete;
+  JsonSnapshot& operator=(const JsonSnapshot&) = delete;
+
+  void Publish(FrozenJson json);
+  void Publish(std::unique_ptr<Json> json);
+
+  /* Owning reference to the current version */
+  FrozenJson Load() const;
+  uint64_t GetVersion() const;
+
+private:
+  std::atomic<FrozenJson> current_;
+  std::atomic<uint64_t> version_;
+};
+
+#endif // !JSON_SNAPSHOT_H
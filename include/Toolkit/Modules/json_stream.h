@@ -0,0 +1,165 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "json.h"
+
+/* Fills buffer with up to size bytes and returns the count, 0 at the end of input */
+using JsonChunkReader = std::function<size_t(char* buffer, size_t size)>;
+
+/*
+ * Forward-only reader over in-memory or chunked input, used by the streaming
+ * parser to find value boundaries without building nodes.
+ * Only one chunk is held at a time; the text of a value being captured is
+ * copied out before the chunk is refilled, so memory stays bounded by the
+ * chunk size plus the largest captured value.
+ */
+class JsonStreamCursor {
+public:
+  static constexpr size_t kDefaultChunkSize = 64 * 1024;
+
+  explicit JsonStreamCursor(std::string_view data);
+  explicit JsonStreamCursor(JsonChunkReader reader, size_t chunk_size = kDefaultChunkSize);
+
+  JsonStreamCursor(const JsonStreamCursor&) = delete;
+  JsonStreamCursor& operator=(const JsonStreamCursor&) = delete;
+
+  /* Skips whitespace and consumes ch if it is next */
+  bool Expect(char ch);
+
+  /* Raw contents of the next string, escapes are left as they are */
+  bool ReadString(std::string& value);
+
+  bool SkipValue();
+
+  /* Appends the raw text of the next value to value */
+  bool CaptureValue(std::string& value);
+
+private:
+  bool Available();
+  void SkipWhitespace();
+  bool ScanValue();
+  bool ScanStringBody();
+  void BeginCapture(std::string& value);
+  void EndCapture();
+
+  std::string chunk_;
+  size_t chunk_size_;
+  JsonChunkReader reader_;
+  const char* pos_;
+  const char* end_;
+  std::string* capture_;
+  const char* capture_start_;
+};
+
+/*
+ * Reads an upstream chunk reader on a worker thread into a ring of
+ * chunk_count buffers, so e.g. decompression overlaps with parsing.
+ * The worker blocks while the ring is full, memory is bounded by
+ * chunk_size * chunk_count.
+ */
+class JsonPipelinedReader {
+public:
+  explicit JsonPipelinedReader(JsonChunkReader source,
+    size_t chunk_size = JsonStreamCursor::kDefaultChunkSize, size_t chunk_count = 4);
+  ~JsonPipelinedReader();
+
+  JsonPipelinedReader(const JsonPipelinedReader&) = delete;
+  JsonPipelinedReader& operator=(const JsonPipelinedReader&) = delete;
+
+  /* JsonChunkReader interface, rethrows exceptions from the source */
+  size_t Read(char* buffer, size_t size);
+
+  /* Reader bound to this object, which must outlive it */
+  JsonChunkReader GetReader();
+
+private:
+  struct Chunk {
+    std::unique_ptr<char[]> data;
+    size_t size = 0;
+  };
+
+  void Produce(std::stop_token stop_token);
+
+  JsonChunkReader source_;
+  size_t chunk_size_;
+  std::vector<Chunk> chunks_;
+  size_t head_;
+  size_t count_;
+  size_t head_offset_;
+  bool finished_;
+  std::exception_ptr error_;
+
+  std::mutex mutex_;
+  std::condition_variable_any not_empty_;
+  std::condition_variable_any not_full_;
+  std::jthread thread_;
+};
+
+/*
+ * Coroutine yielding one parsed node per array element, see JsonParser::ParseElements.
+ * Malformed input yields a node of ValueType::Undefined and ends the sequence.
+ */
+class JsonElementGenerator {
+public:
+  struct promise_type {
+    JsonElementGenerator get_return_object();
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    std::suspend_always yield_value(std::unique_ptr<Json> value) noexcept;
+    void return_void() noexcept {}
+    void unhandled_exception();
+
+    std::unique_ptr<Json> current_;
+    std::exception_ptr exception_;
+  };
+
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  class Iterator {
+  public:
+    using value_type = std::unique_ptr<Json>;
+    using difference_type = std::ptrdiff_t;
+
+    Iterator() = default;
+    explicit Iterator(handle_type handle);
+
+    std::unique_ptr<Json>& operator*() const;
+    Iterator& operator++();
+    void operator++(int);
+    bool operator==(std::default_sentinel_t) const;
+
+  private:
+    handle_type handle_;
+  };
+
+  explicit JsonElementGenerator(handle_type handle);
+  JsonElementGenerator(JsonElementGenerator&& other) noexcept;
+  JsonElementGenerator& operator=(JsonElementGenerator&& other) noexcept;
+  ~JsonElementGenerator();
+
+  JsonElementGenerator(const JsonElementGenerator&) = delete;
+  JsonElementGenerator& operator=(const JsonElementGenerator&) = delete;
+
+  /* Starts the coroutine, iterate once */
+  Iterator begin();
+  std::default_sentinel_t end() const;
+
+private:
+  static void Resume(handle_type handle);
+
+  handle_type handle_;
+};
+
+#endif // !JSON_STREAM_H
@@ -0,0 +1,30 @@
+#ifndef TOOLKIT_H
+#define TOOLKIT_H
+
+/* All included headers */
+
+#include "Modules/json.h"
+#include "Modules/json_parser.h"
+#include "Modules/json_allocator.h"
+#include "Modules/json_builder.h"
+#include "Modules/json_columns.h"
+#include "Modules/json_decompressor.h"
+#include "Modules/json_hash.h"
+#include "Modules/json_packed_array.h"
+#include "Modules/json_snapshot.h"
+#include "Modules/json_stream.h"
+#include "Modules/json_string.h"
+#include "Modules/string_ex.h"
+#include "Modules/filesystem_ex.h"
+#include "Modules/filesystem_batch_read.h"
+#include "Modules/filesystem_cache.h"
+#include "Modules/filesystem_copy.h"
+#include "Modules/filesystem_hash.h"
+#include "Modules/filesystem_listing.h"
+#include "Modules/filesystem_pattern.h"
+#include "Modules/filesystem_pool.h"
+#include "Modules/filesystem_snapshot.h"
+#include "Modules/filesystem_usage.h"
+#include "Modules/filesystem_walk.h"
+
+#endif // !TOOLKIT_H
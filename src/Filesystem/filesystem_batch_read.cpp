@@ -0,0 +1,497 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define FILESYSTEM_HAS_IO_URING
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "filesystem_batch_read.h"
+#include "filesystem_pool.h"
+
+struct Toolkit::FileBatchReader::Job {
+  const char* path = nullptr;
+  std::string* owned = nullptr;   // Grown as needed
+  char* external = nullptr;       // Fixed capacity, used when owned is null
+  size_t capacity = 0;
+  size_t size = 0;
+  size_t first_read = 0;          // File size plus one when known, so the first read sees the end
+  int error = 0;
+  int fd = -1;
+  bool done = false;
+};
+
+namespace {
+  /* Free space after the bytes read so far, growing owned buffers */
+  template<typename T>
+  std::pair<char*, size_t> NextSpace(T& job, size_t read_size)
+  {
+    if (job.owned == nullptr) return { job.external + job.size, job.capacity - job.size };
+
+    if (job.owned->size() == job.size)
+    {
+      size_t first = job.first_read > 0 ? job.first_read : read_size;
+      job.owned->resize(job.size == 0 ? first : std::max(read_size, job.size * 2));
+    }
+    return { job.owned->data() + job.size, job.owned->size() - job.size };
+  }
+
+#ifdef FILESYSTEM_HAS_IO_URING
+  /* Minimal io_uring submission and completion rings over the raw system calls */
+  class Ring {
+  public:
+    Ring() = default;
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    ~Ring()
+    {
+      if (sqes_ != nullptr) munmap(sqes_, sqes_size_);
+      if (cq_ptr_ != nullptr && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_size_);
+      if (sq_ptr_ != nullptr) munmap(sq_ptr_, sq_size_);
+      if (fd_ >= 0) close(fd_);
+    }
+
+    bool Setup(unsigned entries, std::initializer_list<int> required_ops)
+    {
+      io_uring_params params{};
+      fd_ = static_cast<int>(syscall(SYS_io_uring_setup, entries, &params));
+      if (fd_ < 0) return false;
+
+      sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+      cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+      if (params.features & IORING_FEAT_SINGLE_MMAP) sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+
+      sq_ptr_ = Map(sq_size_, IORING_OFF_SQ_RING);
+      if (sq_ptr_ == nullptr) return false;
+
+      cq_ptr_ = (params.features & IORING_FEAT_SINGLE_MMAP) ? sq_ptr_ : Map(cq_size_, IORING_OFF_CQ_RING);
+      if (cq_ptr_ == nullptr) return false;
+
+      sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+      sqes_ = static_cast<io_uring_sqe*>(Map(sqes_size_, IORING_OFF_SQES));
+      if (sqes_ == nullptr) return false;
+
+      auto sq = static_cast<char*>(sq_ptr_);
+      sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+      sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+      sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+      sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+      sq_entries_ = params.sq_entries;
+      sq_local_tail_ = *sq_tail_;
+
+      auto cq = static_cast<char*>(cq_ptr_);
+      cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+      cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+      cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+      cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+      return Supports(required_ops);
+    }
+
+    io_uring_sqe* GetSqe()
+    {
+      unsigned head = std::atomic_ref(*sq_head_).load(std::memory_order_acquire);
+      if (sq_local_tail_ - head >= sq_entries_) return nullptr;
+
+      unsigned index = sq_local_tail_ & sq_mask_;
+      sq_array_[index] = index;
+      sq_local_tail_++;
+      unsubmitted_++;
+
+      auto sqe = &sqes_[index];
+      std::memset(sqe, 0, sizeof(*sqe));
+      return sqe;
+    }
+
+    /* Submits queued entries and waits for at least one completion */
+    bool SubmitAndWait()
+    {
+      std::atomic_ref(*sq_tail_).store(sq_local_tail_, std::memory_order_release);
+      return Enter(unsubmitted_);
+    }
+
+    /* Waits for at least one completion without submitting anything */
+    bool Wait()
+    {
+      return Enter(0);
+    }
+
+    /* Entries queued by GetSqe() that the kernel has not taken yet, it never will without a submit */
+    unsigned GetUnsubmitted() const
+    {
+      return unsubmitted_;
+    }
+
+    bool PopCqe(io_uring_cqe& cqe)
+    {
+      unsigned head = *cq_head_;
+      if (head == std::atomic_ref(*cq_tail_).load(std::memory_order_acquire)) return false;
+
+      cqe = cqes_[head & cq_mask_];
+      std::atomic_ref(*cq_head_).store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+  private:
+    bool Enter(unsigned to_submit)
+    {
+      while (true)
+      {
+        long submitted = syscall(SYS_io_uring_enter, fd_, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (submitted >= 0)
+        {
+          unsubmitted_ -= static_cast<unsigned>(submitted);
+          return true;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) return false;
+      }
+    }
+
+    void* Map(size_t size, off_t offset)
+    {
+      void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+      return ptr == MAP_FAILED ? nullptr : ptr;
+    }
+
+    bool Supports(std::initializer_list<int> ops)
+    {
+      constexpr unsigned kProbeOps = 256;
+      auto storage = std::make_unique<char[]>(sizeof(io_uring_probe) + kProbeOps * sizeof(io_uring_probe_op));
+      std::memset(storage.get(), 0, sizeof(io_uring_probe) + kProbeOps * sizeof(io_uring_probe_op));
+
+      auto probe = reinterpret_cast<io_uring_probe*>(storage.get());
+      if (syscall(SYS_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, kProbeOps) < 0) return false;
+
+      for (int op : ops)
+      {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+      }
+      return true;
+    }
+
+    int fd_ = -1;
+    void* sq_ptr_ = nullptr;
+    void* cq_ptr_ = nullptr;
+    size_t sq_size_ = 0;
+    size_t cq_size_ = 0;
+    size_t sqes_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sq_local_tail_ = 0;
+    unsigned unsubmitted_ = 0;
+
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+  };
+#endif
+}
+
+Toolkit::FileBatchReader::FileBatchReader(Options options)
+  : options_{ options }
+  , used_io_uring_{ false }
+{
+  options_.queue_depth = std::clamp<size_t>(options_.queue_depth, 1, 4096);
+  if (options_.read_size == 0) options_.read_size = Options().read_size;
+}
+
+Toolkit::FileBatchReader::FileBatchReader()
+  : FileBatchReader(Options())
+{
+}
+
+std::vector<Toolkit::FileBatchReader::File> Toolkit::FileBatchReader::Read(const std::vector<std::string>& paths)
+{
+  std::vector<File> files(paths.size());
+  std::vector<Job> jobs(paths.size());
+
+  for (size_t i = 0; i < paths.size(); i++)
+  {
+    if (!buffer_pool_.empty())
+    {
+      files[i].data = std::move(buffer_pool_.back());
+      buffer_pool_.pop_back();
+      files[i].data.clear();
+    }
+
+    jobs[i].path = paths[i].c_str();
+    jobs[i].owned = &files[i].data;
+  }
+
+  Run(jobs);
+
+  for (size_t i = 0; i < paths.size(); i++)
+  {
+    files[i].error = jobs[i].error;
+    files[i].data.resize(jobs[i].error == 0 ? jobs[i].size : 0);
+
+    // Recycled buffers and files that grew while read may be far larger than the data
+    if (files[i].data.capacity() > files[i].data.size() * 2) files[i].data.shrink_to_fit();
+  }
+
+  return files;
+}
+
+void Toolkit::FileBatchReader::Read(const std::vector<std::string>& paths, std::span<const std::span<char>> buffers, std::span<int64_t> sizes)
+{
+  size_t count = std::min({ paths.size(), buffers.size(), sizes.size() });
+  std::vector<Job> jobs(count);
+
+  for (size_t i = 0; i < count; i++)
+  {
+    jobs[i].path = paths[i].c_str();
+    jobs[i].external = buffers[i].data();
+    jobs[i].capacity = buffers[i].size();
+  }
+
+  Run(jobs);
+
+  for (size_t i = 0; i < count; i++)
+  {
+    sizes[i] = jobs[i].error != 0 ? -static_cast<int64_t>(jobs[i].error) : static_cast<int64_t>(jobs[i].size);
+  }
+}
+
+void Toolkit::FileBatchReader::Recycle(std::vector<File>&& files)
+{
+  for (auto& file : files)
+  {
+    if (file.data.capacity() > 0) buffer_pool_.push_back(std::move(file.data));
+  }
+  files.clear();
+}
+
+bool Toolkit::FileBatchReader::UsedIoUring() const
+{
+  return used_io_uring_;
+}
+
+void Toolkit::FileBatchReader::Run(std::vector<Job>& jobs)
+{
+  used_io_uring_ = options_.use_io_uring && RunIoUring(jobs);
+  if (!used_io_uring_) RunThreads(jobs);
+}
+
+bool Toolkit::FileBatchReader::RunIoUring(std::vector<Job>& jobs)
+{
+#ifdef FILESYSTEM_HAS_IO_URING
+  enum Operation : uint64_t { Open, Read, Close };
+
+  Ring ring;
+  if (!ring.Setup(static_cast<unsigned>(options_.queue_depth), { IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE }))
+  {
+    return false;
+  }
+
+  // One operation in flight per file, so the rings never overflow
+  auto submit = [&ring](Job& job, size_t index, Operation operation, size_t read_size) {
+    auto sqe = ring.GetSqe();
+    sqe->user_data = index * 4 + operation;
+
+    switch (operation)
+    {
+    case Open:
+      sqe->opcode = IORING_OP_OPENAT;
+      sqe->fd = AT_FDCWD;
+      sqe->addr = reinterpret_cast<uint64_t>(job.path);
+      sqe->open_flags = O_RDONLY | O_CLOEXEC;
+      break;
+
+    case Read:
+    {
+      auto [data, length] = NextSpace(job, read_size);
+      sqe->opcode = IORING_OP_READ;
+      sqe->fd = job.fd;
+      sqe->addr = reinterpret_cast<uint64_t>(data);
+      sqe->len = static_cast<uint32_t>(std::min<size_t>(length, 1u << 30));
+      sqe->off = job.size;
+      break;
+    }
+
+    case Close:
+      sqe->opcode = IORING_OP_CLOSE;
+      sqe->fd = job.fd;
+      break;
+    }
+  };
+
+  // Waits out the operations the kernel holds so no buffer is written after returning,
+  // then closes what was opened and resets the unfinished jobs for the threads
+  auto drain = [&ring, &jobs](size_t pending) {
+    while (pending > 0)
+    {
+      // Completions are still posted without io_uring_enter, polled between short sleeps
+      if (!ring.Wait()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+      io_uring_cqe cqe;
+      while (ring.PopCqe(cqe))
+      {
+        auto& job = jobs[cqe.user_data / 4];
+        auto operation = static_cast<Operation>(cqe.user_data % 4);
+        pending--;
+
+        if (operation == Open && cqe.res < 0)
+        {
+          job.error = -cqe.res;
+          job.done = true;
+        }
+        else if (operation == Open)
+        {
+          job.fd = cqe.res;
+        }
+        else if (operation == Close)
+        {
+          job.fd = -1;
+          job.done = true;
+        }
+      }
+    }
+
+    for (auto& job : jobs)
+    {
+      if (job.done) continue;
+      if (job.fd >= 0) close(job.fd);
+
+      job.fd = -1;
+      job.size = 0;
+      job.error = 0;
+      job.first_read = 0;
+      if (job.owned != nullptr) job.owned->clear();
+    }
+  };
+
+  size_t next = 0;
+  size_t in_flight = 0;
+
+  while (next < jobs.size() || in_flight > 0)
+  {
+    for (; in_flight < options_.queue_depth && next < jobs.size(); next++, in_flight++)
+    {
+      submit(jobs[next], next, Open, options_.read_size);
+    }
+
+    if (!ring.SubmitAndWait())
+    {
+      drain(in_flight - ring.GetUnsubmitted());
+      return false;
+    }
+
+    io_uring_cqe cqe;
+    while (ring.PopCqe(cqe))
+    {
+      size_t index = cqe.user_data / 4;
+      auto operation = static_cast<Operation>(cqe.user_data % 4);
+      auto& job = jobs[index];
+
+      switch (operation)
+      {
+      case Open:
+        if (cqe.res < 0)
+        {
+          job.error = -cqe.res;
+          job.done = true;
+          in_flight--;
+          break;
+        }
+
+        job.fd = cqe.res;
+        if (job.owned == nullptr && job.capacity == 0)
+        {
+          submit(job, index, Close, 0);
+          break;
+        }
+
+        if (struct stat status; job.owned != nullptr && fstat(job.fd, &status) == 0 && status.st_size >= 0)
+        {
+          job.first_read = static_cast<size_t>(status.st_size) + 1;
+        }
+        submit(job, index, Read, options_.read_size);
+        break;
+
+      case Read:
+        if (cqe.res < 0) job.error = -cqe.res;
+        else job.size += static_cast<size_t>(cqe.res);
+
+        // Stop at the end of the file, on error or when a caller buffer is full
+        if (cqe.res <= 0 || (job.owned == nullptr && job.size == job.capacity)) submit(job, index, Close, 0);
+        else submit(job, index, Read, options_.read_size);
+        break;
+
+      case Close:
+        job.fd = -1;
+        job.done = true;
+        in_flight--;
+        break;
+      }
+    }
+  }
+
+  return true;
+#else
+  (void)jobs;
+  return false;
+#endif
+}
+
+void Toolkit::FileBatchReader::RunThreads(std::vector<Job>& jobs)
+{
+  WorkStealingPool pool{ options_.thread_count };
+
+  for (auto& job : jobs)
+  {
+    if (job.done) continue;
+
+    pool.Submit([&job, read_size = options_.read_size] {
+      errno = 0;
+
+      std::ifstream file;
+      file.rdbuf()->pubsetbuf(nullptr, 0);
+      file.open(std::filesystem::path((const char8_t*)job.path), std::ios::binary);
+
+      if (!file)
+      {
+        job.error = errno != 0 ? errno : EIO;
+        job.done = true;
+        return;
+      }
+
+      std::error_code error;
+      auto file_size = job.owned != nullptr ? std::filesystem::file_size(std::filesystem::path((const char8_t*)job.path), error) : 0;
+      if (!error) job.first_read = static_cast<size_t>(file_size) + 1;
+
+      while (true)
+      {
+        auto [data, length] = NextSpace(job, read_size);
+        if (length == 0) break;
+
+        file.read(data, static_cast<std::streamsize>(length));
+        job.size += static_cast<size_t>(file.gcount());
+        if (static_cast<size_t>(file.gcount()) < length) break;
+      }
+
+      if (file.bad()) job.error = EIO;
+      job.done = true;
+      });
+  }
+
+  pool.Wait();
+}
@@ -0,0 +1,283 @@
+#include <algorithm>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "filesystem_cache.h"
+
+namespace {
+#ifdef __linux__
+  constexpr uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+    | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+#endif
+
+  // A directory still changing after this many listings is returned uncached
+  constexpr size_t kMaxListings = 3;
+
+  void RemoveName(Toolkit::Filesystem::Entries& entries, std::string_view name)
+  {
+    std::erase(entries.dirs, name);
+    std::erase(entries.files, name);
+  }
+}
+
+Toolkit::DirectoryCache::DirectoryCache(size_t capacity)
+  : capacity_{ std::max<size_t>(capacity, 1) }
+  , inotify_fd_{ -1 }
+  , wake_fd_{ -1 }
+{
+#ifdef __linux__
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  if (inotify_fd_ < 0 || wake_fd_ < 0)
+  {
+    if (inotify_fd_ >= 0) close(inotify_fd_);
+    if (wake_fd_ >= 0) close(wake_fd_);
+    inotify_fd_ = -1;
+    wake_fd_ = -1;
+    return;
+  }
+
+  thread_ = std::jthread([this](std::stop_token stop_token) { Watch(stop_token); });
+#endif
+}
+
+Toolkit::DirectoryCache::~DirectoryCache()
+{
+#ifdef __linux__
+  if (thread_.joinable())
+  {
+    thread_.request_stop();
+
+    uint64_t value = 1;
+    [[maybe_unused]] auto written = write(wake_fd_, &value, sizeof(value));
+    thread_.join();
+  }
+
+  if (inotify_fd_ >= 0) close(inotify_fd_);
+  if (wake_fd_ >= 0) close(wake_fd_);
+#endif
+}
+
+Toolkit::DirectoryCache::EntriesPtr Toolkit::DirectoryCache::GetEntries(const std::string& path)
+{
+  {
+    std::lock_guard lock{ mutex_ };
+
+    if (auto it = by_path_.find(path); it != by_path_.end())
+    {
+      lru_.splice(lru_.begin(), lru_, it->second);
+      stats_.hits++;
+      return it->second->entries;
+    }
+
+    stats_.misses++;
+  }
+
+  int watch = -1;
+#ifdef __linux__
+  if (inotify_fd_ >= 0) watch = inotify_add_watch(inotify_fd_, path.c_str(), kWatchMask);
+#endif
+
+  std::unique_lock lock{ mutex_ };
+
+  // Not cacheable, or the same directory is already cached under another path
+  if (watch < 0 || by_watch_.contains(watch))
+  {
+    lock.unlock();
+    return std::make_shared<const Filesystem::Entries>(Filesystem(path).GetEntries());
+  }
+
+  // Listed without the lock, so hits never wait on the disk. The watch is
+  // already in place, any event that arrives meanwhile makes it list again.
+  auto& pending = pending_[watch];
+  pending.listings++;
+
+  EntriesPtr entries;
+  bool settled = false;
+
+  for (size_t listing = 0; listing < kMaxListings && !settled; listing++)
+  {
+    auto generation = pending.generation;
+
+    lock.unlock();
+    entries = std::make_shared<const Filesystem::Entries>(Filesystem(path).GetEntries());
+    lock.lock();
+
+    settled = pending.generation == generation && !pending.ignored;
+  }
+
+  bool ignored = pending.ignored;
+  if (--pending.listings == 0) pending_.erase(watch);
+
+  // Still changing, or another call cached it meanwhile
+  if (!settled || by_watch_.contains(watch) || by_path_.contains(path))
+  {
+#ifdef __linux__
+    if (!ignored && !by_watch_.contains(watch) && !pending_.contains(watch)) inotify_rm_watch(inotify_fd_, watch);
+#endif
+    return entries;
+  }
+
+  lru_.push_front(Directory{ path, watch, entries });
+  by_path_.emplace(path, lru_.begin());
+  by_watch_.emplace(watch, lru_.begin());
+
+  if (lru_.size() > capacity_)
+  {
+    Erase(std::prev(lru_.end()));
+    stats_.evictions++;
+  }
+
+  return entries;
+}
+
+void Toolkit::DirectoryCache::Invalidate(const std::string& path)
+{
+  std::lock_guard lock{ mutex_ };
+
+  if (auto it = by_path_.find(path); it != by_path_.end()) Erase(it->second);
+}
+
+void Toolkit::DirectoryCache::Clear()
+{
+  std::lock_guard lock{ mutex_ };
+
+  while (!lru_.empty()) Erase(lru_.begin());
+}
+
+bool Toolkit::DirectoryCache::IsWatching() const
+{
+  return inotify_fd_ >= 0;
+}
+
+size_t Toolkit::DirectoryCache::Size() const
+{
+  std::lock_guard lock{ mutex_ };
+  return lru_.size();
+}
+
+Toolkit::DirectoryCache::Stats Toolkit::DirectoryCache::GetStats() const
+{
+  std::lock_guard lock{ mutex_ };
+  return stats_;
+}
+
+void Toolkit::DirectoryCache::Erase(LruList::iterator directory)
+{
+#ifdef __linux__
+  // Fails harmlessly when the kernel already dropped the watch
+  inotify_rm_watch(inotify_fd_, directory->watch);
+#endif
+
+  by_watch_.erase(directory->watch);
+  by_path_.erase(directory->path);
+  lru_.erase(directory);
+}
+
+void Toolkit::DirectoryCache::Watch(std::stop_token stop_token)
+{
+#ifdef __linux__
+  alignas(inotify_event) char buffer[64 * 1024];
+
+  pollfd fds[2] = {
+    { inotify_fd_, POLLIN, 0 },
+    { wake_fd_, POLLIN, 0 },
+  };
+
+  while (!stop_token.stop_requested())
+  {
+    if (poll(fds, 2, -1) < 0) continue;
+    if (fds[1].revents != 0) break;
+
+    while (true)
+    {
+      auto size = read(inotify_fd_, buffer, sizeof(buffer));
+      if (size <= 0) break;
+
+      ApplyEvents(buffer, static_cast<size_t>(size));
+    }
+  }
+#else
+  (void)stop_token;
+#endif
+}
+
+void Toolkit::DirectoryCache::ApplyEvents(const char* data, size_t size)
+{
+#ifdef __linux__
+  namespace fs = std::filesystem;
+
+  std::lock_guard lock{ mutex_ };
+
+  // Copy on write, once per directory and batch of events
+  std::unordered_map<int, std::shared_ptr<Filesystem::Entries>> updated;
+
+  for (size_t offset = 0; offset < size; )
+  {
+    auto event = reinterpret_cast<const inotify_event*>(data + offset);
+    offset += sizeof(inotify_event) + event->len;
+
+    stats_.events++;
+
+    if (event->mask & IN_Q_OVERFLOW)
+    {
+      updated.clear();
+      while (!lru_.empty()) Erase(lru_.begin());
+      for (auto& [watch, pending] : pending_) pending.generation++;
+      continue;
+    }
+
+    auto it = by_watch_.find(event->wd);
+    if (it == by_watch_.end())
+    {
+      if (auto pending = pending_.find(event->wd); pending != pending_.end())
+      {
+        pending->second.generation++;
+        if (event->mask & IN_IGNORED) pending->second.ignored = true;
+      }
+      continue;
+    }
+
+    auto directory = it->second;
+
+    if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED | IN_UNMOUNT))
+    {
+      updated.erase(event->wd);
+      Erase(directory);
+      continue;
+    }
+
+    if (event->len == 0) continue;
+
+    auto& entries = updated[event->wd];
+    if (entries == nullptr) entries = std::make_shared<Filesystem::Entries>(*directory->entries);
+
+    std::string_view name{ event->name };
+    RemoveName(*entries, name);
+
+    if (event->mask & (IN_CREATE | IN_MOVED_TO))
+    {
+      // Symlinks to directories are listed as directories, like in Filesystem::GetEntries()
+      std::error_code error;
+      bool is_dir = (event->mask & IN_ISDIR) || fs::is_directory(fs::path(directory->path) / name, error);
+
+      if (is_dir) entries->dirs.emplace_back(name);
+      else entries->files.emplace_back(name);
+    }
+  }
+
+  for (auto& [watch, entries] : updated)
+  {
+    by_watch_.at(watch)->entries = std::move(entries);
+  }
+#else
+  (void)data;
+  (void)size;
+#endif
+}
@@ -0,0 +1,87 @@
+#ifndef FILESYSTEM_CACHE_H
+#define FILESYSTEM_CACHE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "filesystem_ex.h"
+
+namespace Toolkit {
+
+  /*
+   * Directory listings kept in memory and kept current with inotify.
+   * A background thread applies created, deleted and renamed entries to the
+   * cached listings, and drops a listing when its directory goes away or the
+   * event queue overflows. At most capacity directories are watched, the
+   * least recently used one is evicted first. Misses are listed outside the
+   * lock, so hits never wait on the disk.
+   * Without inotify (other platforms, watch limit reached) listings are read
+   * from disk on every call.
+   */
+  class DirectoryCache {
+  public:
+    using EntriesPtr = std::shared_ptr<const Filesystem::Entries>;
+
+    struct Stats {
+      size_t hits = 0;
+      size_t misses = 0;
+      size_t events = 0;
+      size_t evictions = 0;
+    };
+
+    explicit DirectoryCache(size_t capacity = 1024);
+    ~DirectoryCache();
+
+    DirectoryCache(const DirectoryCache&) = delete;
+    DirectoryCache& operator=(const DirectoryCache&) = delete;
+
+    /* Same contents as Filesystem::GetEntries() for path, the result is an immutable snapshot */
+    EntriesPtr GetEntries(const std::string& path);
+
+    void Invalidate(const std::string& path);
+    void Clear();
+
+    bool IsWatching() const;
+    size_t Size() const;
+    Stats GetStats() const;
+
+  private:
+    struct Directory {
+      std::string path;
+      int watch;
+      EntriesPtr entries;
+    };
+
+    /* Watch of a directory that GetEntries() is listing outside the lock */
+    struct PendingListing {
+      size_t listings = 0;
+      uint64_t generation = 0;  // Bumped by every event, a listing that saw it changing is redone
+      bool ignored = false;     // The kernel dropped the watch, the listing is not cached
+    };
+
+    using LruList = std::list<Directory>;
+
+    void Watch(std::stop_token stop_token);
+    void ApplyEvents(const char* data, size_t size);
+    void Erase(LruList::iterator directory);
+
+    size_t capacity_;
+    int inotify_fd_;
+    int wake_fd_;
+
+    mutable std::mutex mutex_;
+    LruList lru_;  // Most recently used first
+    std::unordered_map<std::string, LruList::iterator> by_path_;
+    std::unordered_map<int, LruList::iterator> by_watch_;
+    std::unordered_map<int, PendingListing> pending_;
+    Stats stats_;
+
+    std::jthread thread_;
+  };
+}
+
+#endif // !FILESYSTEM_CACHE_H
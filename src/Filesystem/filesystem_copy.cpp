@@ -0,0 +1,432 @@
+#include <algorithm>
+#include <cerrno>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "filesystem_copy.h"
+#include "filesystem_ex.h"
+#include "filesystem_pool.h"
+
+namespace {
+  // Bytes per copy call, which is also how often progress is reported
+  constexpr size_t kChunkSize = 8 * 1024 * 1024;
+
+  // Files sized by one task before copying
+  constexpr size_t kSizeBatch = 256;
+
+  using Existing = Toolkit::CopyOptions::Existing;
+
+  struct CopyJob {
+    std::string from;
+    std::string to;
+    uint64_t size = 0;
+  };
+
+  /* Shared counters and failures of one Copy() */
+  class CopyState {
+  public:
+    explicit CopyState(const Toolkit::CopyOptions& options)
+      : options_{ options }
+    {
+    }
+
+    void AddTotals(uint64_t bytes, size_t files)
+    {
+      std::lock_guard lock{ mutex_ };
+      result_.progress.bytes_total += bytes;
+      result_.progress.files_total += files;
+    }
+
+    void AddCopied(uint64_t bytes, size_t files)
+    {
+      std::lock_guard lock{ mutex_ };
+      result_.progress.bytes_copied += bytes;
+      result_.progress.files_copied += files;
+      if (options_.progress) options_.progress(result_.progress);
+    }
+
+    void AddFailure(const std::string& path, std::error_code error)
+    {
+      std::lock_guard lock{ mutex_ };
+      result_.failures.push_back({ path, error });
+    }
+
+    Toolkit::CopyResult TakeResult()
+    {
+      std::lock_guard lock{ mutex_ };
+      return std::move(result_);
+    }
+
+  private:
+    const Toolkit::CopyOptions& options_;
+    std::mutex mutex_;
+    Toolkit::CopyResult result_;
+  };
+
+  std::filesystem::path ToPath(const std::string& path)
+  {
+    return std::filesystem::path((const char8_t*)path.c_str());
+  }
+
+  std::error_code LastError()
+  {
+    return { errno, std::generic_category() };
+  }
+
+#ifdef __linux__
+  /* Moves the data of in to out in the kernel, falling back from cloning to plain reads and writes */
+  std::error_code TransferData(int in, int out, const Toolkit::CopyOptions& options, CopyState& state)
+  {
+    enum class Method { CopyFileRange, Sendfile, ReadWrite };
+
+    if (options.reflink && ioctl(out, FICLONE, in) == 0)
+    {
+      struct stat status;
+      if (fstat(in, &status) == 0) state.AddCopied(static_cast<uint64_t>(status.st_size), 0);
+      return {};
+    }
+
+    auto method = Method::CopyFileRange;
+    std::unique_ptr<char[]> buffer;
+
+    while (true)
+    {
+      ssize_t count = 0;
+
+      switch (method)
+      {
+      case Method::CopyFileRange:
+        count = copy_file_range(in, nullptr, out, nullptr, kChunkSize, 0);
+        if (count < 0 && (errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP || errno == EINVAL || errno == EPERM))
+        {
+          method = Method::Sendfile;
+          continue;
+        }
+        break;
+
+      case Method::Sendfile:
+        count = sendfile(out, in, nullptr, kChunkSize);
+        if (count < 0 && (errno == EINVAL || errno == ENOSYS))
+        {
+          method = Method::ReadWrite;
+          continue;
+        }
+        break;
+
+      case Method::ReadWrite:
+      {
+        if (buffer == nullptr) buffer = std::make_unique<char[]>(kChunkSize);
+
+        count = read(in, buffer.get(), kChunkSize);
+        for (ssize_t written = 0; count > 0 && written < count;)
+        {
+          ssize_t result = write(out, buffer.get() + written, static_cast<size_t>(count - written));
+          if (result < 0 && errno == EINTR) continue;
+          if (result < 0) return LastError();
+          written += result;
+        }
+        break;
+      }
+      }
+
+      if (count < 0 && errno == EINTR) continue;
+      if (count < 0) return LastError();
+      if (count == 0) return {};
+
+      state.AddCopied(static_cast<uint64_t>(count), 0);
+    }
+  }
+
+  std::error_code CopyFile(const CopyJob& job, const Toolkit::CopyOptions& options, CopyState& state)
+  {
+    int in = open(job.from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) return LastError();
+
+    struct stat status;
+    if (fstat(in, &status) != 0)
+    {
+      auto error = LastError();
+      close(in);
+      return error;
+    }
+
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (options.existing == Existing::Overwrite ? 0 : O_EXCL);
+    int out = open(job.to.c_str(), flags, status.st_mode & 0777);
+    if (out < 0)
+    {
+      auto error = LastError();
+      close(in);
+      return options.existing == Existing::Skip && error == std::errc::file_exists ? std::error_code() : error;
+    }
+
+    // Truncating only now keeps a copy of a file onto itself from destroying it
+    struct stat target;
+    std::error_code error;
+    if (fstat(out, &target) != 0) error = LastError();
+    else if (target.st_dev == status.st_dev && target.st_ino == status.st_ino) error = std::make_error_code(std::errc::file_exists);
+    else if (ftruncate(out, 0) != 0) error = LastError();
+    else error = TransferData(in, out, options, state);
+
+    if (!error && options.preserve_metadata)
+    {
+      // Ownership first, changing it clears the set-user-ID bits. Only root may give files away.
+      timespec times[2] = { status.st_atim, status.st_mtim };
+      if (fchown(out, status.st_uid, status.st_gid) != 0 && errno != EPERM) error = LastError();
+      else if (fchmod(out, status.st_mode & 07777) != 0 || futimens(out, times) != 0) error = LastError();
+    }
+
+    if (close(out) != 0 && !error) error = LastError();
+    close(in);
+
+    return error;
+  }
+#else
+  std::error_code CopyFile(const CopyJob& job, const Toolkit::CopyOptions& options, CopyState& state)
+  {
+    namespace fs = std::filesystem;
+
+    auto copy_options = fs::copy_options::none;
+    if (options.existing == Existing::Overwrite) copy_options = fs::copy_options::overwrite_existing;
+    if (options.existing == Existing::Skip) copy_options = fs::copy_options::skip_existing;
+
+    std::error_code error;
+    bool copied = fs::copy_file(ToPath(job.from), ToPath(job.to), copy_options, error);
+    if (error || !copied) return error;
+
+    if (options.preserve_metadata)
+    {
+      auto time = fs::last_write_time(ToPath(job.from), error);
+      if (!error) fs::last_write_time(ToPath(job.to), time, error);
+    }
+
+    if (!error) state.AddCopied(job.size, 0);
+    return error;
+  }
+#endif
+
+  std::error_code CopySymlink(const std::string& from, const std::string& to, const Toolkit::CopyOptions& options)
+  {
+    namespace fs = std::filesystem;
+
+    std::error_code error;
+    auto target = fs::read_symlink(ToPath(from), error);
+    if (error) return error;
+
+    if (fs::exists(fs::symlink_status(ToPath(to), error)))
+    {
+      if (options.existing == Existing::Skip) return {};
+      if (options.existing == Existing::Fail) return std::make_error_code(std::errc::file_exists);
+      fs::remove(ToPath(to), error);
+      if (error) return error;
+    }
+
+    fs::create_symlink(target, ToPath(to), error);
+    return error;
+  }
+
+  /* Creates the directory to or accepts an existing one, metadata follows once it is filled */
+  std::error_code CreateDirectory(const std::string& to)
+  {
+    namespace fs = std::filesystem;
+
+    std::error_code error;
+    fs::create_directory(ToPath(to), error);
+    if (!error && !fs::is_directory(ToPath(to), error) && !error) error = std::make_error_code(std::errc::not_a_directory);
+    return error;
+  }
+
+  void CopyDirectoryMetadata(const std::string& from, const std::string& to)
+  {
+    namespace fs = std::filesystem;
+
+    std::error_code error;
+    auto status = fs::status(ToPath(from), error);
+    if (error) return;
+
+    fs::permissions(ToPath(to), status.permissions(), error);
+
+    auto time = fs::last_write_time(ToPath(from), error);
+    if (!error) fs::last_write_time(ToPath(to), time, error);
+  }
+}
+
+bool Toolkit::CopyResult::Succeeded() const
+{
+  return failures.empty();
+}
+
+Toolkit::FileCopier::FileCopier(CopyOptions options)
+  : options_{ options }
+{
+}
+
+Toolkit::CopyResult Toolkit::FileCopier::Copy(const std::string& from, const std::string& to)
+{
+  namespace fs = std::filesystem;
+
+  CopyState state{ options_ };
+
+  std::error_code error;
+  auto status = fs::symlink_status(ToPath(from), error);
+  if (error)
+  {
+    state.AddFailure(from, error);
+    return state.TakeResult();
+  }
+
+  if (fs::is_symlink(status))
+  {
+    error = CopySymlink(from, to, options_);
+    if (error) state.AddFailure(from, error);
+    return state.TakeResult();
+  }
+
+  if (!fs::is_directory(status))
+  {
+    CopyJob job{ from, to, fs::file_size(ToPath(from), error) };
+    if (error)
+    {
+      state.AddFailure(from, error);
+      return state.TakeResult();
+    }
+
+    state.AddTotals(job.size, 1);
+    error = CopyFile(job, options_, state);
+    if (error) state.AddFailure(from, error);
+    state.AddCopied(0, 1);
+    return state.TakeResult();
+  }
+
+  error = CreateDirectory(to);
+  if (error)
+  {
+    state.AddFailure(from, error);
+    return state.TakeResult();
+  }
+
+  auto root_size = from.size() + (from.ends_with('/') ? 0 : 1);
+  auto destination = to.ends_with('/') ? to : to + '/';
+
+  std::vector<CopyJob> directories;
+  std::vector<CopyJob> files;
+  std::vector<CopyJob> symlinks;
+
+  // A directory that cannot be listed would be copied empty, and Move() must then keep the source
+  WalkOptions walk_options;
+  walk_options.thread_count = options_.thread_count;
+  walk_options.on_error = [&state](const std::string& path, std::error_code walk_error) { state.AddFailure(path, walk_error); };
+
+  Filesystem::Walk(from, walk_options, [&](std::span<const WalkEntry> entries) {
+    for (auto& entry : entries)
+    {
+      CopyJob job{ entry.path, destination + entry.path.substr(std::min(root_size, entry.path.size())) };
+
+      switch (entry.type)
+      {
+      case EntryType::Directory: directories.push_back(std::move(job)); break;
+      case EntryType::File:      files.push_back(std::move(job)); break;
+      case EntryType::Symlink:   symlinks.push_back(std::move(job)); break;
+      default:                   state.AddFailure(entry.path, std::make_error_code(std::errc::not_supported)); break;
+      }
+    }
+    return true;
+    });
+
+  // A parent sorts before its children, so the tree is created top down
+  std::sort(directories.begin(), directories.end(), [](const CopyJob& a, const CopyJob& b) { return a.to < b.to; });
+  for (auto& directory : directories)
+  {
+    error = CreateDirectory(directory.to);
+    if (error) state.AddFailure(directory.from, error);
+  }
+
+  WorkStealingPool pool{ options_.thread_count };
+
+  for (size_t start = 0; start < files.size(); start += kSizeBatch)
+  {
+    pool.Submit([&files, &state, start] {
+      size_t end = std::min(start + kSizeBatch, files.size());
+      uint64_t bytes = 0;
+
+      for (size_t i = start; i < end; i++)
+      {
+        std::error_code size_error;
+        files[i].size = std::filesystem::file_size(ToPath(files[i].from), size_error);
+        if (!size_error) bytes += files[i].size;
+      }
+
+      state.AddTotals(bytes, end - start);
+      });
+  }
+  pool.Wait();
+
+  // Largest files first, so that one big file does not finish alone at the end
+  std::sort(files.begin(), files.end(), [](const CopyJob& a, const CopyJob& b) { return a.size > b.size; });
+
+  for (auto& file : files)
+  {
+    pool.Submit([&file, &state, &options = options_] {
+      auto copy_error = CopyFile(file, options, state);
+      if (copy_error) state.AddFailure(file.from, copy_error);
+      state.AddCopied(0, 1);
+      });
+  }
+  pool.Wait();
+
+  for (auto& symlink : symlinks)
+  {
+    error = CopySymlink(symlink.from, symlink.to, options_);
+    if (error) state.AddFailure(symlink.from, error);
+  }
+
+  // Last and bottom up, so that filling a directory does not change its time and read-only ones could be filled
+  if (options_.preserve_metadata)
+  {
+    for (auto directory = directories.rbegin(); directory != directories.rend(); ++directory)
+    {
+      CopyDirectoryMetadata(directory->from, directory->to);
+    }
+    CopyDirectoryMetadata(from, to);
+  }
+
+  return state.TakeResult();
+}
+
+Toolkit::CopyResult Toolkit::FileCopier::Move(const std::string& from, const std::string& to)
+{
+  namespace fs = std::filesystem;
+
+  CopyResult result;
+
+  std::error_code error;
+  if (options_.existing != CopyOptions::Existing::Overwrite && fs::exists(fs::symlink_status(ToPath(to), error)))
+  {
+    if (options_.existing == CopyOptions::Existing::Fail) result.failures.push_back({ from, std::make_error_code(std::errc::file_exists) });
+    return result;
+  }
+
+  fs::rename(ToPath(from), ToPath(to), error);
+  if (error != std::errc::cross_device_link)
+  {
+    if (error) result.failures.push_back({ from, error });
+    return result;
+  }
+
+  result = Copy(from, to);
+  if (!result.Succeeded()) return result;
+
+  fs::remove_all(ToPath(from), error);
+  if (error) result.failures.push_back({ from, error });
+
+  return result;
+}
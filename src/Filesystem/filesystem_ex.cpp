@@ -4,6 +4,7 @@
 #include "filesystem_ex.h"
 #include <algorithm>
 #include "string_ex.h"
+#include "filesystem_cache.h"
 
 
 Toolkit::Filesystem::Filesystem()
@@ -40,21 +41,32 @@ bool Toolkit::Filesystem::VisitDir(const std::string& dir_name)
   return true;
 }
 
+namespace {
+  // One listing buffer per thread, shared by the StrList getters
+  Toolkit::DirectoryListing& ReusableListing()
+  {
+    thread_local Toolkit::DirectoryListing listing;
+    return listing;
+  }
+}
+
 Toolkit::Filesystem::StrList Toolkit::Filesystem::GetDirs()
 {
-  namespace fs = std::filesystem;
+  if (cache_) return cache_->GetEntries(GetCurrentPath())->dirs;
 
   StrList dirs;
 
-  if (fs::exists(path_) && fs::is_directory(path_))
+  auto& listing = ReusableListing();
+  if (List(listing))
   {
-    for (auto const& entry : fs::directory_iterator{ path_ })
+    for (const auto& entry : listing)
     {
-      if (fs::is_directory(entry))
+      if (listing.GetTargetType(entry) == EntryType::Directory)
       {
-        dirs.push_back(PathToUtf8(entry.path().filename()));
+        dirs.emplace_back(entry.name);
       }
     }
+    listing.Close();
   }
 
   return dirs;
@@ -62,19 +74,50 @@ Toolkit::Filesystem::StrList Toolkit::Filesystem::GetDirs()
 
 Toolkit::Filesystem::StrList Toolkit::Filesystem::GetFiles()
 {
-  namespace fs = std::filesystem;
+  if (cache_) return cache_->GetEntries(GetCurrentPath())->files;
 
   StrList files;
 
-  if (fs::exists(path_) && fs::is_directory(path_))
+  auto& listing = ReusableListing();
+  if (List(listing))
   {
-    for (auto const& entry : fs::directory_iterator{ path_ })
+    for (const auto& entry : listing)
     {
-      if (!fs::is_directory(entry))
+      if (listing.GetTargetType(entry) != EntryType::Directory)
       {
-        files.push_back(PathToUtf8(entry.path().filename()));
+        files.emplace_back(entry.name);
       }
     }
+    listing.Close();
+  }
+
+  return files;
+}
+
+Toolkit::Filesystem::StrList Toolkit::Filesystem::GetFiles(const PathPattern& pattern)
+{
+  StrList files;
+
+  if (cache_)
+  {
+    for (const auto& name : cache_->GetEntries(GetCurrentPath())->files)
+    {
+      if (pattern.Matches(name)) files.push_back(name);
+    }
+    return files;
+  }
+
+  auto& listing = ReusableListing();
+  if (List(listing))
+  {
+    for (const auto& entry : listing)
+    {
+      if (pattern.Matches(entry.name) && listing.GetTargetType(entry) != EntryType::Directory)
+      {
+        files.emplace_back(entry.name);
+      }
+    }
+    listing.Close();
   }
 
   return files;
@@ -82,27 +125,39 @@ Toolkit::Filesystem::StrList Toolkit::Filesystem::GetFiles()
 
 Toolkit::Filesystem::Entries Toolkit::Filesystem::GetEntries()
 {
-  namespace fs = std::filesystem;
+  if (cache_) return *cache_->GetEntries(GetCurrentPath());
 
   Entries entries;
 
-  if (fs::exists(path_) && fs::is_directory(path_))
+  auto& listing = ReusableListing();
+  if (List(listing))
   {
-    for (auto const& entry : fs::directory_iterator{ path_ })
+    for (const auto& entry : listing)
     {
-      if (!fs::is_directory(entry)) entries.files.push_back(PathToUtf8(entry.path().filename()));
-      else entries.dirs.push_back(PathToUtf8(entry.path().filename()));
+      if (listing.GetTargetType(entry) != EntryType::Directory) entries.files.emplace_back(entry.name);
+      else entries.dirs.emplace_back(entry.name);
     }
+    listing.Close();
   }
 
   return entries;
 }
 
+bool Toolkit::Filesystem::List(DirectoryListing& listing) const
+{
+  return listing.Open(PathToUtf8(path_));
+}
+
 void Toolkit::Filesystem::SetPath(const std::string& path_str)
 {
   path_ = Utf8ToPath(path_str);
 }
 
+void Toolkit::Filesystem::SetCache(std::shared_ptr<DirectoryCache> cache)
+{
+  cache_ = std::move(cache);
+}
+
 bool Toolkit::Filesystem::PathExists(const std::string& path_str)
 {
   auto path = Utf8ToPath(path_str);
@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+#include "filesystem_hash.h"
+#include "filesystem_ex.h"
+#include "filesystem_pool.h"
+#include "json_hash.h"
+
+namespace {
+  // Files are first told apart by this many leading bytes
+  constexpr uint64_t kPrefixSize = 64 * 1024;
+
+  // Fast digests chain one JsonHashBytes per chunk of this size, reads are whole chunks
+  constexpr size_t kHashChunk = 64 * 1024;
+
+  class Sha256 {
+  public:
+    void Update(const unsigned char* data, size_t size)
+    {
+      total_ += size;
+
+      while (size > 0)
+      {
+        size_t count = std::min(size, sizeof(block_) - used_);
+        std::memcpy(block_ + used_, data, count);
+        used_ += count;
+        data += count;
+        size -= count;
+
+        if (used_ == sizeof(block_))
+        {
+          Transform(block_);
+          used_ = 0;
+        }
+      }
+    }
+
+    void Final(uint8_t* digest)
+    {
+      uint64_t bits = total_ * 8;
+
+      unsigned char padding[72] = { 0x80 };
+      size_t padding_size = (used_ < 56 ? 56 : 120) - used_;
+      Update(padding, padding_size);
+
+      unsigned char length[8];
+      for (int i = 0; i < 8; i++) length[i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+      Update(length, 8);
+
+      for (int i = 0; i < 8; i++)
+      {
+        for (int j = 0; j < 4; j++) digest[i * 4 + j] = static_cast<uint8_t>(state_[i] >> (24 - 8 * j));
+      }
+    }
+
+  private:
+    static uint32_t Rotate(uint32_t value, int count)
+    {
+      return (value >> count) | (value << (32 - count));
+    }
+
+    void Transform(const unsigned char* block)
+    {
+      static constexpr uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+      };
+
+      uint32_t w[64];
+      for (int i = 0; i < 16; i++)
+      {
+        w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16)
+          | (uint32_t(block[i * 4 + 2]) << 8) | uint32_t(block[i * 4 + 3]);
+      }
+      for (int i = 16; i < 64; i++)
+      {
+        uint32_t s0 = Rotate(w[i - 15], 7) ^ Rotate(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = Rotate(w[i - 2], 17) ^ Rotate(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+      }
+
+      uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+      uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+
+      for (int i = 0; i < 64; i++)
+      {
+        uint32_t t1 = h + (Rotate(e, 6) ^ Rotate(e, 11) ^ Rotate(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+        uint32_t t2 = (Rotate(a, 2) ^ Rotate(a, 13) ^ Rotate(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+      }
+
+      state_[0] += a; state_[1] += b; state_[2] += c; state_[3] += d;
+      state_[4] += e; state_[5] += f; state_[6] += g; state_[7] += h;
+    }
+
+    uint32_t state_[8] = {
+      0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    unsigned char block_[64] = {};
+    size_t used_ = 0;
+    uint64_t total_ = 0;
+  };
+
+  std::filesystem::path ToPath(const std::string& path)
+  {
+    return std::filesystem::path((const char8_t*)path.c_str());
+  }
+
+  /* Hashes up to limit leading bytes of the file into digest */
+  void HashFile(Toolkit::FileDigest& digest, uint64_t limit, const Toolkit::FileHashOptions& options, char* buffer)
+  {
+    using Algorithm = Toolkit::FileHashOptions::Algorithm;
+
+    digest.valid = false;
+
+    std::ifstream file;
+    file.rdbuf()->pubsetbuf(nullptr, 0);
+    file.open(ToPath(digest.path), std::ios::binary);
+    if (!file) return;
+
+    Sha256 sha256;
+    uint64_t fast = 0;
+    uint64_t total = 0;
+
+    // Reads are whole chunks until the end, so digests do not depend on block_size
+    while (total < limit)
+    {
+      auto wanted = static_cast<std::streamsize>(std::min<uint64_t>(options.block_size, limit - total));
+      file.read(buffer, wanted);
+      auto count = static_cast<size_t>(file.gcount());
+      if (count == 0) break;
+
+      if (options.algorithm == Algorithm::Sha256) sha256.Update(reinterpret_cast<unsigned char*>(buffer), count);
+      else
+      {
+        for (size_t offset = 0; offset < count; offset += kHashChunk)
+        {
+          fast = JsonHashBytes(buffer + offset, std::min(kHashChunk, count - offset), fast);
+        }
+      }
+
+      total += count;
+      if (count < static_cast<size_t>(wanted)) break;
+    }
+
+    if (file.bad()) return;
+
+    if (options.algorithm == Algorithm::Sha256)
+    {
+      sha256.Final(digest.digest.data());
+      digest.digest_size = 32;
+    }
+    else
+    {
+      fast = JsonHashMix(fast, total);
+      std::memcpy(digest.digest.data(), &fast, sizeof(fast));
+      digest.digest_size = sizeof(fast);
+    }
+
+    digest.valid = true;
+  }
+
+  /* Runs HashFile over digests on the pool, one read buffer per worker */
+  void HashAll(std::vector<Toolkit::FileDigest*>& digests, uint64_t limit, const Toolkit::FileHashOptions& options)
+  {
+    Toolkit::WorkStealingPool pool{ options.thread_count };
+    std::vector<std::unique_ptr<char[]>> buffers(pool.GetThreadCount());
+
+    for (auto digest : digests)
+    {
+      pool.Submit([&pool, &buffers, &options, digest, limit] {
+        auto& buffer = buffers[pool.GetWorkerIndex()];
+        if (buffer == nullptr) buffer = std::make_unique<char[]>(options.block_size);
+
+        HashFile(*digest, limit, options, buffer.get());
+        });
+    }
+
+    pool.Wait();
+  }
+
+  /* Splits every group by digest, dropping unreadable files and groups left with one file */
+  std::vector<std::vector<Toolkit::FileDigest*>> SplitByDigest(const std::vector<std::vector<Toolkit::FileDigest*>>& groups)
+  {
+    std::vector<std::vector<Toolkit::FileDigest*>> result;
+
+    for (auto& group : groups)
+    {
+      std::map<std::array<uint8_t, 32>, std::vector<Toolkit::FileDigest*>> by_digest;
+      for (auto digest : group)
+      {
+        if (digest->valid) by_digest[digest->digest].push_back(digest);
+      }
+
+      for (auto& [key, members] : by_digest)
+      {
+        if (members.size() > 1) result.push_back(std::move(members));
+      }
+    }
+
+    return result;
+  }
+}
+
+std::string Toolkit::FileDigest::ToHex() const
+{
+  static constexpr char digits[] = "0123456789abcdef";
+
+  std::string hex;
+  hex.reserve(digest_size * 2);
+  for (size_t i = 0; i < digest_size; i++)
+  {
+    hex += digits[digest[i] >> 4];
+    hex += digits[digest[i] & 0x0F];
+  }
+  return hex;
+}
+
+bool Toolkit::FileDigest::operator==(const FileDigest& other) const
+{
+  return valid && other.valid && size == other.size && digest == other.digest;
+}
+
+Toolkit::FileHasher::FileHasher(FileHashOptions options)
+  : options_{ options }
+{
+  if (options_.block_size == 0) options_.block_size = FileHashOptions().block_size;
+  options_.block_size = (options_.block_size + kHashChunk - 1) / kHashChunk * kHashChunk;
+}
+
+std::vector<Toolkit::FileDigest> Toolkit::FileHasher::Hash(const std::vector<std::string>& paths)
+{
+  std::vector<FileDigest> digests(paths.size());
+  std::vector<FileDigest*> pending;
+  pending.reserve(paths.size());
+
+  for (size_t i = 0; i < paths.size(); i++)
+  {
+    digests[i].path = paths[i];
+
+    std::error_code error;
+    digests[i].size = std::filesystem::file_size(ToPath(paths[i]), error);
+    if (!error) pending.push_back(&digests[i]);
+  }
+
+  HashAll(pending, std::numeric_limits<uint64_t>::max(), options_);
+  return digests;
+}
+
+std::vector<Toolkit::DuplicateGroup> Toolkit::FileHasher::FindDuplicates(const std::vector<std::string>& paths)
+{
+  std::vector<FileDigest> digests(paths.size());
+
+  // Sizes first, a file with a unique size has no duplicate. Empty files are all alike, skip them
+  std::unordered_map<uint64_t, std::vector<FileDigest*>> by_size;
+  for (size_t i = 0; i < paths.size(); i++)
+  {
+    digests[i].path = paths[i];
+
+    std::error_code error;
+    digests[i].size = std::filesystem::file_size(ToPath(paths[i]), error);
+    if (error || (digests[i].size == 0 && !options_.include_empty)) continue;
+
+    by_size[digests[i].size].push_back(&digests[i]);
+  }
+
+  std::vector<std::vector<FileDigest*>> groups;
+  std::vector<FileDigest*> candidates;
+  for (auto& [size, group] : by_size)
+  {
+    if (group.size() < 2) continue;
+
+    candidates.insert(candidates.end(), group.begin(), group.end());
+    groups.push_back(std::move(group));
+  }
+
+  // Leading bytes, then the whole content of files that still collide
+  HashAll(candidates, kPrefixSize, options_);
+  groups = SplitByDigest(groups);
+
+  candidates.clear();
+  std::vector<std::vector<FileDigest*>> hashed;
+  for (auto& group : groups)
+  {
+    if (group.front()->size <= kPrefixSize) continue;
+
+    candidates.insert(candidates.end(), group.begin(), group.end());
+    hashed.push_back(std::move(group));
+  }
+
+  HashAll(candidates, std::numeric_limits<uint64_t>::max(), options_);
+  hashed = SplitByDigest(hashed);
+
+  std::vector<DuplicateGroup> duplicates;
+  for (auto* source : { &groups, &hashed })
+  {
+    for (auto& group : *source)
+    {
+      if (group.empty()) continue;
+
+      DuplicateGroup duplicate;
+      duplicate.size = group.front()->size;
+      for (auto digest : group) duplicate.paths.push_back(digest->path);
+      std::sort(duplicate.paths.begin(), duplicate.paths.end());
+
+      duplicates.push_back(std::move(duplicate));
+    }
+  }
+
+  std::sort(duplicates.begin(), duplicates.end(), [](const DuplicateGroup& a, const DuplicateGroup& b) {
+    return a.size != b.size ? a.size > b.size : a.paths < b.paths;
+    });
+
+  return duplicates;
+}
+
+std::vector<Toolkit::DuplicateGroup> Toolkit::FileHasher::FindDuplicates(const std::string& root)
+{
+  std::vector<std::string> paths;
+
+  WalkOptions options;
+  options.symlinks = WalkOptions::Symlinks::Skip;
+  options.thread_count = options_.thread_count;
+
+  Filesystem::Walk(root, options, [&paths](std::span<const WalkEntry> entries) {
+    for (auto& entry : entries)
+    {
+      if (entry.type == EntryType::File) paths.push_back(entry.path);
+    }
+    return true;
+    });
+
+  return FindDuplicates(paths);
+}
@@ -0,0 +1,293 @@
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "filesystem_listing.h"
+
+namespace {
+#ifdef __linux__
+  // Layout of struct linux_dirent64
+  constexpr size_t kRecordLengthOffset = 16;
+  constexpr size_t kTypeOffset = 18;
+  constexpr size_t kNameOffset = 19;
+
+  Toolkit::EntryType FromMode(mode_t mode)
+  {
+    if (S_ISREG(mode)) return Toolkit::EntryType::File;
+    if (S_ISDIR(mode)) return Toolkit::EntryType::Directory;
+    if (S_ISLNK(mode)) return Toolkit::EntryType::Symlink;
+    return Toolkit::EntryType::Other;
+  }
+
+  Toolkit::EntryType FromDirentType(unsigned char type)
+  {
+    switch (type)
+    {
+    case DT_REG: return Toolkit::EntryType::File;
+    case DT_DIR: return Toolkit::EntryType::Directory;
+    case DT_LNK: return Toolkit::EntryType::Symlink;
+    default:     return Toolkit::EntryType::Other;
+    }
+  }
+
+  bool IsDotEntry(std::string_view name)
+  {
+    return name == "." || name == "..";
+  }
+#else
+  Toolkit::EntryType FromStatus(const std::filesystem::file_status& status)
+  {
+    namespace fs = std::filesystem;
+
+    if (fs::is_regular_file(status)) return Toolkit::EntryType::File;
+    if (fs::is_directory(status)) return Toolkit::EntryType::Directory;
+    if (fs::is_symlink(status)) return Toolkit::EntryType::Symlink;
+    return Toolkit::EntryType::Other;
+  }
+#endif
+}
+
+Toolkit::DirectoryListing::Iterator::Iterator(DirectoryListing* listing)
+  : listing_{ listing }
+{
+}
+
+const Toolkit::DirectoryListing::Entry& Toolkit::DirectoryListing::Iterator::operator*() const
+{
+  return listing_->entry_;
+}
+
+const Toolkit::DirectoryListing::Entry* Toolkit::DirectoryListing::Iterator::operator->() const
+{
+  return &listing_->entry_;
+}
+
+Toolkit::DirectoryListing::Iterator& Toolkit::DirectoryListing::Iterator::operator++()
+{
+  listing_->Next();
+  return *this;
+}
+
+void Toolkit::DirectoryListing::Iterator::operator++(int)
+{
+  ++*this;
+}
+
+bool Toolkit::DirectoryListing::Iterator::operator==(std::default_sentinel_t) const
+{
+  return listing_ == nullptr || listing_->finished_;
+}
+
+Toolkit::DirectoryListing::Iterator Toolkit::DirectoryListing::begin()
+{
+  if (!started_)
+  {
+    started_ = true;
+    Next();
+  }
+
+  return Iterator(this);
+}
+
+std::default_sentinel_t Toolkit::DirectoryListing::end() const
+{
+  return std::default_sentinel;
+}
+
+std::error_code Toolkit::DirectoryListing::GetError() const
+{
+  return error_;
+}
+
+#ifdef __linux__
+
+Toolkit::DirectoryListing::DirectoryListing(size_t buffer_size)
+  : fd_{ -1 }
+  , buffer_size_{ buffer_size > 1024 ? buffer_size : 1024 }
+  , buffer_pos_{ 0 }
+  , buffer_end_{ 0 }
+  , entry_{}
+  , started_{ false }
+  , finished_{ true }
+{
+  buffer_ = std::make_unique<char[]>(buffer_size_);
+}
+
+Toolkit::DirectoryListing::~DirectoryListing()
+{
+  Close();
+}
+
+bool Toolkit::DirectoryListing::Open(const std::string& path)
+{
+  Close();
+  error_.clear();
+
+  fd_ = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd_ < 0)
+  {
+    error_ = std::error_code(errno, std::system_category());
+    return false;
+  }
+
+  entry_ = Entry();
+  started_ = false;
+  finished_ = false;
+  return true;
+}
+
+void Toolkit::DirectoryListing::Close()
+{
+  if (fd_ >= 0) ::close(fd_);
+
+  fd_ = -1;
+  buffer_pos_ = 0;
+  buffer_end_ = 0;
+  finished_ = true;
+}
+
+bool Toolkit::DirectoryListing::IsOpen() const
+{
+  return fd_ >= 0;
+}
+
+Toolkit::EntryType Toolkit::DirectoryListing::GetTargetType(const Entry& entry) const
+{
+  if (entry.type != EntryType::Symlink) return entry.type;
+
+  struct stat status;
+  if (::fstatat(fd_, entry.name.data(), &status, 0) != 0) return EntryType::Symlink;
+  return FromMode(status.st_mode);
+}
+
+int Toolkit::DirectoryListing::GetDescriptor() const
+{
+  return fd_;
+}
+
+bool Toolkit::DirectoryListing::Refill()
+{
+  auto count = ::syscall(SYS_getdents64, fd_, buffer_.get(), buffer_size_);
+  if (count < 0) error_ = std::error_code(errno, std::system_category());
+  if (count <= 0) return false;
+
+  buffer_pos_ = 0;
+  buffer_end_ = static_cast<size_t>(count);
+  return true;
+}
+
+bool Toolkit::DirectoryListing::Next()
+{
+  while (!finished_)
+  {
+    if (buffer_pos_ == buffer_end_ && !Refill())
+    {
+      finished_ = true;
+      break;
+    }
+
+    const char* record = buffer_.get() + buffer_pos_;
+
+    uint16_t record_length;
+    std::memcpy(&record_length, record + kRecordLengthOffset, sizeof(record_length));
+    buffer_pos_ += record_length;
+
+    std::string_view name{ record + kNameOffset };
+    if (IsDotEntry(name)) continue;
+
+    auto type = static_cast<unsigned char>(record[kTypeOffset]);
+    entry_.name = name;
+    entry_.type = FromDirentType(type);
+
+    // Filesystems without d_type support
+    struct stat status;
+    if (type == DT_UNKNOWN && ::fstatat(fd_, name.data(), &status, AT_SYMLINK_NOFOLLOW) == 0)
+    {
+      entry_.type = FromMode(status.st_mode);
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+#else
+
+Toolkit::DirectoryListing::DirectoryListing(size_t)
+  : is_open_{ false }
+  , entry_{}
+  , started_{ false }
+  , finished_{ true }
+{
+}
+
+Toolkit::DirectoryListing::~DirectoryListing() = default;
+
+bool Toolkit::DirectoryListing::Open(const std::string& path)
+{
+  namespace fs = std::filesystem;
+
+  Close();
+  error_.clear();
+
+  path_ = fs::path((const char8_t*)path.c_str());
+  iterator_ = fs::directory_iterator(path_, fs::directory_options::skip_permission_denied, error_);
+  if (error_) return false;
+
+  entry_ = Entry();
+  is_open_ = true;
+  started_ = false;
+  finished_ = false;
+  return true;
+}
+
+void Toolkit::DirectoryListing::Close()
+{
+  iterator_ = std::filesystem::directory_iterator();
+  is_open_ = false;
+  finished_ = true;
+}
+
+bool Toolkit::DirectoryListing::IsOpen() const
+{
+  return is_open_;
+}
+
+Toolkit::EntryType Toolkit::DirectoryListing::GetTargetType(const Entry& entry) const
+{
+  if (entry.type != EntryType::Symlink) return entry.type;
+
+  std::error_code error;
+  auto status = std::filesystem::status(path_ / std::filesystem::path((const char8_t*)name_.c_str()), error);
+  return error ? EntryType::Symlink : FromStatus(status);
+}
+
+bool Toolkit::DirectoryListing::Next()
+{
+  std::error_code error;
+
+  // The first entry is already loaded by the iterator
+  if (started_ && entry_.name.data() != nullptr) iterator_.increment(error);
+
+  if (error || iterator_ == std::filesystem::directory_iterator())
+  {
+    error_ = error;
+    finished_ = true;
+    return false;
+  }
+
+  name_ = (const char*)iterator_->path().filename().generic_u8string().c_str();
+  entry_.name = name_;
+  entry_.type = FromStatus(iterator_->symlink_status(error));
+  return true;
+}
+
+#endif
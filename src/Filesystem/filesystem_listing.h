@@ -0,0 +1,109 @@
+#ifndef FILESYSTEM_LISTING_H
+#define FILESYSTEM_LISTING_H
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#ifndef __linux__
+#include <filesystem>
+#endif
+
+namespace Toolkit {
+
+  enum class EntryType : int8_t {
+    File,
+    Directory,
+    Symlink,  // Not followed, or broken
+    Other,
+  };
+
+  /*
+   * Single pass directory reader with a reusable buffer.
+   * On Linux entries are read in bulk with getdents64 and typed from d_type,
+   * stat is only needed on filesystems that do not report it. Names are views
+   * into the buffer (NUL terminated), valid until the iterator advances.
+   * "." and ".." are skipped. Other platforms use std::filesystem.
+   */
+  class DirectoryListing {
+  public:
+    static constexpr size_t kDefaultBufferSize = 64 * 1024;
+
+    struct Entry {
+      std::string_view name;
+      EntryType type;
+    };
+
+    class Iterator {
+    public:
+      using value_type = Entry;
+      using difference_type = std::ptrdiff_t;
+
+      Iterator() = default;
+      explicit Iterator(DirectoryListing* listing);
+
+      const Entry& operator*() const;
+      const Entry* operator->() const;
+      Iterator& operator++();
+      void operator++(int);
+      bool operator==(std::default_sentinel_t) const;
+
+    private:
+      DirectoryListing* listing_ = nullptr;
+    };
+
+    explicit DirectoryListing(size_t buffer_size = kDefaultBufferSize);
+    ~DirectoryListing();
+
+    DirectoryListing(const DirectoryListing&) = delete;
+    DirectoryListing& operator=(const DirectoryListing&) = delete;
+
+    /* Closes the previous directory, the buffer is kept */
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const;
+
+    /* Why the last Open() failed or the listing ended early, empty otherwise */
+    std::error_code GetError() const;
+
+    /* Type of what a symlink entry points to, Symlink when it is broken */
+    EntryType GetTargetType(const Entry& entry) const;
+
+#ifdef __linux__
+    /* Descriptor of the open directory, for *at() calls on its entries */
+    int GetDescriptor() const;
+#endif
+
+    /* Iterate once per Open() */
+    Iterator begin();
+    std::default_sentinel_t end() const;
+
+  private:
+    bool Next();
+
+#ifdef __linux__
+    bool Refill();
+
+    int fd_;
+    std::unique_ptr<char[]> buffer_;
+    size_t buffer_size_;
+    size_t buffer_pos_;
+    size_t buffer_end_;
+#else
+    std::filesystem::path path_;
+    std::filesystem::directory_iterator iterator_;
+    std::string name_;
+    bool is_open_;
+#endif
+
+    Entry entry_;
+    std::error_code error_;
+    bool started_;
+    bool finished_;
+  };
+}
+
+#endif // !FILESYSTEM_LISTING_H
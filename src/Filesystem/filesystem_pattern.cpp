@@ -0,0 +1,331 @@
+#include "filesystem_pattern.h"
+
+namespace {
+  // Upper bound for the alternatives of nested brace sets
+  constexpr size_t kMaxAlternatives = 4096;
+
+  // Matching state is one bit per component
+  constexpr size_t kMaxComponents = 63;
+
+  /* Index of the ']' closing a class that starts at open, or npos */
+  size_t FindClassEnd(std::string_view text, size_t open)
+  {
+    size_t i = open + 1;
+    if (i < text.size() && (text[i] == '!' || text[i] == '^')) i++;
+    if (i < text.size() && text[i] == ']') i++;
+
+    for (; i < text.size(); i++)
+    {
+      if (text[i] == ']') return i;
+    }
+    return std::string_view::npos;
+  }
+
+  /* Expands the first brace set of pattern recursively, false on unbalanced braces */
+  bool ExpandBraces(std::string_view pattern, std::vector<std::string>& expanded)
+  {
+    size_t open = std::string_view::npos;
+    size_t close = std::string_view::npos;
+    std::vector<size_t> commas;
+    int depth = 0;
+
+    for (size_t i = 0; i < pattern.size() && close == std::string_view::npos; i++)
+    {
+      switch (pattern[i])
+      {
+      case '\\':
+        i++;
+        break;
+
+      case '[':
+      {
+        size_t end = FindClassEnd(pattern, i);
+        if (end != std::string_view::npos) i = end;
+        break;
+      }
+
+      case '{':
+        if (depth++ == 0) open = i;
+        break;
+
+      case ',':
+        if (depth == 1) commas.push_back(i);
+        break;
+
+      case '}':
+        if (depth == 0) return false;
+        if (--depth == 0) close = i;
+        break;
+      }
+    }
+
+    if (depth != 0) return false;
+
+    if (open == std::string_view::npos)
+    {
+      if (expanded.size() >= kMaxAlternatives) return false;
+      expanded.emplace_back(pattern);
+      return true;
+    }
+
+    auto prefix = pattern.substr(0, open);
+    auto suffix = pattern.substr(close + 1);
+
+    commas.push_back(close);
+    size_t start = open + 1;
+    for (auto end : commas)
+    {
+      std::string alternative;
+      alternative.reserve(prefix.size() + (end - start) + suffix.size());
+      alternative.append(prefix).append(pattern.substr(start, end - start)).append(suffix);
+
+      if (!ExpandBraces(alternative, expanded)) return false;
+      start = end + 1;
+    }
+
+    return true;
+  }
+
+  template<typename T>
+  void ForEachComponent(std::string_view path, const T& function)
+  {
+    size_t start = 0;
+    while (start <= path.size())
+    {
+      size_t end = path.find('/', start);
+      if (end == std::string_view::npos) end = path.size();
+
+      if (end > start) function(path.substr(start, end - start));
+      start = end + 1;
+    }
+  }
+}
+
+Toolkit::PathPattern Toolkit::PathPattern::Glob(std::string_view pattern)
+{
+  PathPattern compiled;
+
+  std::vector<std::string> expanded;
+  if (!ExpandBraces(pattern, expanded))
+  {
+    compiled.valid_ = false;
+    return compiled;
+  }
+
+  for (const auto& text : expanded)
+  {
+    Alternative alternative;
+
+    ForEachComponent(text, [&](std::string_view component) {
+      Segment segment;
+      if (component == "**") segment.globstar = true;
+      else if (!ParseSegment(component, segment)) compiled.valid_ = false;
+
+      // Consecutive "**" are one
+      if (segment.globstar && !alternative.empty() && alternative.back().globstar) return;
+      alternative.push_back(std::move(segment));
+      });
+
+    if (alternative.size() > kMaxComponents) compiled.valid_ = false;
+    compiled.alternatives_.push_back(std::move(alternative));
+  }
+
+  if (!compiled.valid_) compiled.alternatives_.clear();
+  return compiled;
+}
+
+Toolkit::PathPattern Toolkit::PathPattern::Regex(const std::string& pattern)
+{
+  PathPattern compiled;
+
+  try
+  {
+    compiled.regex_ = std::make_shared<const std::regex>(pattern, std::regex::ECMAScript | std::regex::optimize);
+  }
+  catch (const std::regex_error&)
+  {
+    compiled.valid_ = false;
+  }
+
+  return compiled;
+}
+
+bool Toolkit::PathPattern::IsValid() const
+{
+  return valid_;
+}
+
+bool Toolkit::PathPattern::IsEmpty() const
+{
+  return valid_ && regex_ == nullptr && alternatives_.empty();
+}
+
+bool Toolkit::PathPattern::Matches(std::string_view path) const
+{
+  if (!valid_) return false;
+  if (regex_ != nullptr) return std::regex_match(path.begin(), path.end(), *regex_);
+  if (alternatives_.empty()) return true;
+
+  for (const auto& alternative : alternatives_)
+  {
+    if (Simulate(alternative, path) >> alternative.size() & 1) return true;
+  }
+  return false;
+}
+
+bool Toolkit::PathPattern::CanMatchBelow(std::string_view directory) const
+{
+  if (!valid_) return false;
+  if (regex_ != nullptr || alternatives_.empty()) return true;
+
+  for (const auto& alternative : alternatives_)
+  {
+    // A state short of the end can still consume more components
+    uint64_t pending = (uint64_t(1) << alternative.size()) - 1;
+    if (Simulate(alternative, directory) & pending) return true;
+  }
+  return false;
+}
+
+bool Toolkit::PathPattern::ParseSegment(std::string_view text, Segment& segment)
+{
+  using Kind = Token::Kind;
+
+  for (size_t i = 0; i < text.size(); i++)
+  {
+    Token token{ Kind::Literal, text[i], {} };
+
+    switch (text[i])
+    {
+    case '\\':
+      if (++i == text.size()) return false;
+      token.literal = text[i];
+      break;
+
+    case '?':
+      token.kind = Kind::AnyChar;
+      break;
+
+    case '*':
+      if (!segment.tokens.empty() && segment.tokens.back().kind == Kind::AnySequence) continue;
+      token.kind = Kind::AnySequence;
+      break;
+
+    case '[':
+    {
+      size_t end = FindClassEnd(text, i);
+      if (end == std::string_view::npos) return false;
+
+      token.kind = Kind::Class;
+      size_t j = i + 1;
+      bool negate = text[j] == '!' || text[j] == '^';
+      if (negate) j++;
+
+      for (bool first = true; j < end; j++, first = false)
+      {
+        auto from = static_cast<unsigned char>(text[j]);
+        if (j + 2 < end && text[j + 1] == '-' && !(first && text[j] == ']'))
+        {
+          auto to = static_cast<unsigned char>(text[j + 2]);
+          for (unsigned ch = from; ch <= to; ch++) token.set.set(ch);
+          j += 2;
+        }
+        else
+        {
+          token.set.set(from);
+        }
+      }
+
+      if (negate) token.set.flip();
+      i = end;
+      break;
+    }
+
+    default:
+      break;
+    }
+
+    segment.tokens.push_back(token);
+  }
+
+  return true;
+}
+
+bool Toolkit::PathPattern::MatchSegment(const Segment& segment, std::string_view name)
+{
+  using Kind = Token::Kind;
+
+  auto matches = [](const Token& token, char ch) {
+    switch (token.kind)
+    {
+    case Kind::Literal: return token.literal == ch;
+    case Kind::AnyChar: return true;
+    case Kind::Class:   return token.set.test(static_cast<unsigned char>(ch));
+    default:            return false;
+    }
+  };
+
+  const auto& tokens = segment.tokens;
+  size_t token = 0;
+  size_t pos = 0;
+
+  // Backtrack to the last '*' only, which keeps matching linear in practice
+  size_t star = std::string_view::npos;
+  size_t star_pos = 0;
+
+  while (pos < name.size())
+  {
+    if (token < tokens.size() && tokens[token].kind == Kind::AnySequence)
+    {
+      star = token++;
+      star_pos = pos;
+    }
+    else if (token < tokens.size() && matches(tokens[token], name[pos]))
+    {
+      token++;
+      pos++;
+    }
+    else if (star != std::string_view::npos)
+    {
+      token = star + 1;
+      pos = ++star_pos;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  while (token < tokens.size() && tokens[token].kind == Kind::AnySequence) token++;
+  return token == tokens.size();
+}
+
+uint64_t Toolkit::PathPattern::Simulate(const Alternative& alternative, std::string_view path)
+{
+  // Bit i: the components read so far can be followed by segment i, like an NFA
+  auto closure = [&alternative](uint64_t states) {
+    for (size_t i = 0; i < alternative.size(); i++)
+    {
+      if ((states >> i & 1) && alternative[i].globstar) states |= uint64_t(1) << (i + 1);
+    }
+    return states;
+  };
+
+  uint64_t states = closure(1);
+
+  ForEachComponent(path, [&](std::string_view component) {
+    uint64_t next = 0;
+
+    for (size_t i = 0; i < alternative.size(); i++)
+    {
+      if (!(states >> i & 1)) continue;
+
+      if (alternative[i].globstar) next |= uint64_t(1) << i;
+      else if (MatchSegment(alternative[i], component)) next |= uint64_t(1) << (i + 1);
+    }
+
+    states = closure(next);
+    });
+
+  return states;
+}
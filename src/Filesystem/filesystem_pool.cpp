@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <utility>
+
+#include "filesystem_pool.h"
+
+namespace {
+  // Pool and queue index of the current worker thread
+  thread_local const Toolkit::WorkStealingPool* current_pool = nullptr;
+  thread_local size_t current_index = 0;
+}
+
+Toolkit::WorkStealingPool::WorkStealingPool(size_t thread_count)
+  : queued_{ 0 }
+  , pending_{ 0 }
+  , next_queue_{ 0 }
+{
+  if (thread_count == 0) thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+  queues_.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; i++) queues_.push_back(std::make_unique<Queue>());
+
+  threads_.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; i++)
+  {
+    threads_.emplace_back([this, i](std::stop_token stop_token) { Run(stop_token, i); });
+  }
+}
+
+Toolkit::WorkStealingPool::~WorkStealingPool()
+{
+  for (auto& thread : threads_) thread.request_stop();
+  threads_.clear();
+}
+
+void Toolkit::WorkStealingPool::Submit(Task task)
+{
+  size_t index = GetWorkerIndex();
+  if (index == queues_.size()) index = next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+
+  pending_.fetch_add(1);
+
+  {
+    std::lock_guard lock{ queues_[index]->mutex };
+    queues_[index]->tasks.push_back(std::move(task));
+  }
+
+  // Counted under mutex_, so a worker going to sleep cannot miss it
+  {
+    std::lock_guard lock{ mutex_ };
+    queued_.fetch_add(1);
+  }
+  wake_.notify_one();
+}
+
+void Toolkit::WorkStealingPool::Wait()
+{
+  std::unique_lock lock{ mutex_ };
+  done_.wait(lock, [this] { return pending_.load() == 0; });
+
+  if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+size_t Toolkit::WorkStealingPool::GetThreadCount() const
+{
+  return queues_.size();
+}
+
+size_t Toolkit::WorkStealingPool::GetWorkerIndex() const
+{
+  return current_pool == this ? current_index : queues_.size();
+}
+
+void Toolkit::WorkStealingPool::Run(std::stop_token stop_token, size_t index)
+{
+  current_pool = this;
+  current_index = index;
+
+  Task task;
+  while (!stop_token.stop_requested())
+  {
+    if (!TakeTask(index, task))
+    {
+      std::unique_lock lock{ mutex_ };
+      wake_.wait(lock, stop_token, [this] { return queued_.load() > 0; });
+      continue;
+    }
+
+    try
+    {
+      task();
+    }
+    catch (...)
+    {
+      std::lock_guard lock{ mutex_ };
+      if (!error_) error_ = std::current_exception();
+    }
+    task = nullptr;
+
+    if (pending_.fetch_sub(1) == 1)
+    {
+      std::lock_guard lock{ mutex_ };
+      done_.notify_all();
+    }
+  }
+}
+
+bool Toolkit::WorkStealingPool::TakeTask(size_t index, Task& task)
+{
+  if (queued_.load() == 0) return false;
+
+  // Own tasks newest first, then the oldest task of another worker
+  for (size_t i = 0; i < queues_.size(); i++)
+  {
+    auto& queue = *queues_[(index + i) % queues_.size()];
+    std::lock_guard lock{ queue.mutex };
+    if (queue.tasks.empty()) continue;
+
+    if (i == 0)
+    {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    }
+    else
+    {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+
+    queued_.fetch_sub(1);
+    return true;
+  }
+
+  return false;
+}
@@ -0,0 +1,426 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#include "filesystem_snapshot.h"
+#include "filesystem_ex.h"
+#include "filesystem_hash.h"
+#include "filesystem_pool.h"
+
+namespace {
+  constexpr char kSnapshotMagic[4] = { 'T', 'K', 'S', 'N' };
+  constexpr uint8_t kSnapshotVersion = 1;
+
+  // Entries stat'ed by one task
+  constexpr size_t kStatBatch = 1024;
+
+  enum EntryFlags : uint8_t {
+    kHasHash = 1,
+  };
+
+  std::filesystem::path ToPath(const std::string& path)
+  {
+    return std::filesystem::path((const char8_t*)path.c_str());
+  }
+
+  std::string JoinPath(const std::string& root, std::string_view relative)
+  {
+    std::string path;
+    path.reserve(root.size() + relative.size() + 1);
+    path.append(root);
+    if (path.empty() || path.back() != '/') path += '/';
+    path.append(relative);
+    return path;
+  }
+
+  void StatEntry(const std::string& path, Toolkit::SnapshotEntry& entry)
+  {
+#ifdef __linux__
+    struct statx status;
+    if (statx(AT_FDCWD, path.c_str(), AT_SYMLINK_NOFOLLOW, STATX_SIZE | STATX_MTIME | STATX_INO, &status) != 0) return;
+
+    entry.size = status.stx_size;
+    entry.mtime = status.stx_mtime.tv_sec * 1'000'000'000 + status.stx_mtime.tv_nsec;
+    entry.inode = status.stx_ino;
+#else
+    namespace fs = std::filesystem;
+
+    std::error_code error;
+    if (entry.type == Toolkit::EntryType::File) entry.size = fs::file_size(ToPath(path), error);
+
+    auto time = fs::last_write_time(ToPath(path), error);
+    if (!error) entry.mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+#endif
+  }
+
+  bool IsModified(const Toolkit::SnapshotEntry& before, const Toolkit::SnapshotEntry& after)
+  {
+    if (before.type != after.type) return true;
+
+    // Their size and mtime follow their contents, which are entries of their own
+    if (before.type == Toolkit::EntryType::Directory) return false;
+
+    if (before.size != after.size || before.mtime != after.mtime) return true;
+    return before.has_hash && after.has_hash && before.hash != after.hash;
+  }
+
+  void WriteVarint(std::string& out, uint64_t value)
+  {
+    while (value >= 0x80)
+    {
+      out += static_cast<char>((value & 0x7F) | 0x80);
+      value >>= 7;
+    }
+    out += static_cast<char>(value);
+  }
+
+  class Reader {
+  public:
+    Reader(const char* data, size_t size)
+      : pos_{ data }
+      , end_{ data + size }
+    {
+    }
+
+    bool ReadVarint(uint64_t& value)
+    {
+      value = 0;
+      for (int shift = 0; shift < 64 && pos_ < end_; shift += 7)
+      {
+        auto byte = static_cast<uint8_t>(*pos_++);
+        value |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+      }
+      return false;
+    }
+
+    bool ReadBytes(size_t size, const char*& data)
+    {
+      if (static_cast<size_t>(end_ - pos_) < size) return false;
+      data = pos_;
+      pos_ += size;
+      return true;
+    }
+
+    bool AtEnd() const
+    {
+      return pos_ == end_;
+    }
+
+  private:
+    const char* pos_;
+    const char* end_;
+  };
+}
+
+Toolkit::TreeSnapshot Toolkit::TreeSnapshot::Capture(const std::string& root, const SnapshotOptions& options)
+{
+  TreeSnapshot snapshot;
+  snapshot.root_ = root;
+
+  struct Found {
+    std::string path;
+    EntryType type;
+  };
+
+  std::vector<Found> found;
+  size_t root_size = root.size() + (root.ends_with('/') ? 0 : 1);
+
+  WalkOptions walk_options;
+  walk_options.thread_count = options.thread_count;
+
+  Filesystem::Walk(root, walk_options, [&found, root_size](std::span<const WalkEntry> entries) {
+    for (auto& entry : entries)
+    {
+      found.push_back({ entry.path.substr(std::min(root_size, entry.path.size())), entry.type });
+    }
+    return true;
+    });
+
+  std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) { return a.path < b.path; });
+
+  std::string joined;
+  std::vector<uint32_t> lengths;
+  lengths.reserve(found.size());
+  snapshot.entries_.resize(found.size());
+
+  for (size_t i = 0; i < found.size(); i++)
+  {
+    joined.append(found[i].path);
+    lengths.push_back(static_cast<uint32_t>(found[i].path.size()));
+    snapshot.entries_[i].type = found[i].type;
+  }
+
+  found = {};
+  snapshot.SetPaths(joined, lengths);
+
+  auto& entries = snapshot.entries_;
+  {
+    WorkStealingPool pool{ options.thread_count };
+    for (size_t start = 0; start < entries.size(); start += kStatBatch)
+    {
+      pool.Submit([&entries, &root, start] {
+        size_t end = std::min(start + kStatBatch, entries.size());
+        for (size_t i = start; i < end; i++) StatEntry(JoinPath(root, entries[i].path), entries[i]);
+        });
+    }
+    pool.Wait();
+  }
+
+  if (options.hash_files)
+  {
+    std::vector<std::string> paths;
+    std::vector<SnapshotEntry*> files;
+
+    for (auto& entry : entries)
+    {
+      if (entry.type != EntryType::File) continue;
+
+      paths.push_back(JoinPath(root, entry.path));
+      files.push_back(&entry);
+    }
+
+    FileHashOptions hash_options;
+    hash_options.thread_count = options.thread_count;
+
+    auto digests = FileHasher(hash_options).Hash(paths);
+    for (size_t i = 0; i < digests.size(); i++)
+    {
+      if (!digests[i].valid) continue;
+
+      std::memcpy(&files[i]->hash, digests[i].digest.data(), sizeof(uint64_t));
+      files[i]->has_hash = true;
+    }
+  }
+
+  return snapshot;
+}
+
+bool Toolkit::TreeSnapshot::Save(const std::string& file_path) const
+{
+  std::string out;
+  out.append(kSnapshotMagic, sizeof(kSnapshotMagic));
+  out += static_cast<char>(kSnapshotVersion);
+
+  WriteVarint(out, root_.size());
+  out.append(root_);
+  WriteVarint(out, entries_.size());
+
+  std::string_view previous;
+  for (const auto& entry : entries_)
+  {
+    auto mismatch = std::mismatch(previous.begin(), previous.end(), entry.path.begin(), entry.path.end());
+    auto shared = static_cast<size_t>(mismatch.first - previous.begin());
+    previous = entry.path;
+
+    WriteVarint(out, shared);
+    WriteVarint(out, entry.path.size() - shared);
+    out.append(entry.path.substr(shared));
+
+    out += static_cast<char>(entry.type);
+    out += static_cast<char>(entry.has_hash ? kHasHash : 0);
+    WriteVarint(out, entry.size);
+    WriteVarint(out, (static_cast<uint64_t>(entry.mtime) << 1) ^ static_cast<uint64_t>(entry.mtime >> 63));
+    WriteVarint(out, entry.inode);
+
+    if (entry.has_hash)
+    {
+      for (int i = 0; i < 8; i++) out += static_cast<char>(entry.hash >> (8 * i));
+    }
+  }
+
+  std::ofstream file(ToPath(file_path), std::ios::binary | std::ios::trunc);
+  file.write(out.data(), static_cast<std::streamsize>(out.size()));
+  return static_cast<bool>(file.flush());
+}
+
+bool Toolkit::TreeSnapshot::Load(const std::string& file_path)
+{
+  std::ifstream file(ToPath(file_path), std::ios::binary);
+  if (!file) return false;
+
+  std::string data{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+  if (file.bad()) return false;
+
+  Reader reader{ data.data(), data.size() };
+  const char* bytes = nullptr;
+  uint64_t root_size = 0;
+  uint64_t count = 0;
+
+  if (!reader.ReadBytes(sizeof(kSnapshotMagic), bytes) || std::memcmp(bytes, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0) return false;
+  if (!reader.ReadBytes(1, bytes) || static_cast<uint8_t>(*bytes) != kSnapshotVersion) return false;
+  if (!reader.ReadVarint(root_size) || !reader.ReadBytes(root_size, bytes)) return false;
+
+  std::string root(bytes, root_size);
+  if (!reader.ReadVarint(count) || count > data.size()) return false;
+
+  std::vector<SnapshotEntry> entries(count);
+  std::string joined;
+  std::vector<uint32_t> lengths;
+  lengths.reserve(count);
+
+  std::string previous;
+
+  for (auto& entry : entries)
+  {
+    uint64_t shared = 0;
+    uint64_t suffix = 0;
+    uint64_t mtime = 0;
+
+    if (!reader.ReadVarint(shared) || shared > previous.size()) return false;
+    if (!reader.ReadVarint(suffix) || !reader.ReadBytes(suffix, bytes)) return false;
+
+    previous.resize(shared);
+    previous.append(bytes, suffix);
+    joined.append(previous);
+    lengths.push_back(static_cast<uint32_t>(previous.size()));
+
+    const char* header = nullptr;
+    if (!reader.ReadBytes(2, header) || static_cast<uint8_t>(header[0]) > static_cast<uint8_t>(EntryType::Other)) return false;
+
+    entry.type = static_cast<EntryType>(header[0]);
+    entry.has_hash = (header[1] & kHasHash) != 0;
+
+    if (!reader.ReadVarint(entry.size) || !reader.ReadVarint(mtime) || !reader.ReadVarint(entry.inode)) return false;
+    entry.mtime = static_cast<int64_t>((mtime >> 1) ^ (~(mtime & 1) + 1));
+
+    if (entry.has_hash)
+    {
+      if (!reader.ReadBytes(8, bytes)) return false;
+      for (int i = 0; i < 8; i++) entry.hash |= uint64_t(static_cast<uint8_t>(bytes[i])) << (8 * i);
+    }
+  }
+
+  if (!reader.AtEnd()) return false;
+
+  root_ = std::move(root);
+  entries_ = std::move(entries);
+  SetPaths(joined, lengths);
+  return true;
+}
+
+const std::string& Toolkit::TreeSnapshot::GetRoot() const
+{
+  return root_;
+}
+
+const std::vector<Toolkit::SnapshotEntry>& Toolkit::TreeSnapshot::GetEntries() const
+{
+  return entries_;
+}
+
+const Toolkit::SnapshotEntry* Toolkit::TreeSnapshot::Find(std::string_view path) const
+{
+  auto found = std::lower_bound(entries_.begin(), entries_.end(), path, [](const SnapshotEntry& entry, std::string_view value) {
+    return entry.path < value;
+    });
+
+  return found != entries_.end() && found->path == path ? &*found : nullptr;
+}
+
+std::vector<Toolkit::SnapshotChange> Toolkit::TreeSnapshot::Diff(const TreeSnapshot& before, const TreeSnapshot& after)
+{
+  using Kind = SnapshotChange::Kind;
+
+  const auto& old_entries = before.entries_;
+  const auto& new_entries = after.entries_;
+
+  std::vector<SnapshotChange> changes;
+  std::vector<const SnapshotEntry*> removed;
+  std::vector<const SnapshotEntry*> added;
+
+  size_t i = 0;
+  size_t j = 0;
+  while (i < old_entries.size() || j < new_entries.size())
+  {
+    if (j == new_entries.size() || (i < old_entries.size() && old_entries[i].path < new_entries[j].path))
+    {
+      removed.push_back(&old_entries[i++]);
+    }
+    else if (i == old_entries.size() || new_entries[j].path < old_entries[i].path)
+    {
+      added.push_back(&new_entries[j++]);
+    }
+    else
+    {
+      if (IsModified(old_entries[i], new_entries[j])) changes.push_back({ Kind::Modified, std::string(new_entries[j].path), {} });
+      i++;
+      j++;
+    }
+  }
+
+  // A rename keeps the inode, a copy to another filesystem and back keeps the content
+  std::unordered_multimap<uint64_t, size_t> by_inode;
+  std::unordered_multimap<uint64_t, size_t> by_hash;
+  for (size_t k = 0; k < removed.size(); k++)
+  {
+    if (removed[k]->inode != 0) by_inode.emplace(removed[k]->inode, k);
+    if (removed[k]->has_hash && removed[k]->size > 0) by_hash.emplace(removed[k]->hash, k);
+  }
+
+  std::vector<bool> renamed(removed.size());
+
+  auto take = [&removed, &renamed](const std::unordered_multimap<uint64_t, size_t>& index, uint64_t key, const auto& matches) {
+    auto [first, last] = index.equal_range(key);
+    for (auto it = first; it != last; ++it)
+    {
+      if (renamed[it->second] || !matches(*removed[it->second])) continue;
+
+      renamed[it->second] = true;
+      return removed[it->second];
+    }
+    return static_cast<const SnapshotEntry*>(nullptr);
+  };
+
+  for (auto entry : added)
+  {
+    const SnapshotEntry* source = nullptr;
+
+    if (entry->inode != 0)
+    {
+      source = take(by_inode, entry->inode, [entry](const SnapshotEntry& old) {
+        return old.type == entry->type && (old.type == EntryType::Directory || (old.size == entry->size && old.mtime == entry->mtime));
+        });
+    }
+
+    if (source == nullptr && entry->has_hash && entry->size > 0)
+    {
+      source = take(by_hash, entry->hash, [entry](const SnapshotEntry& old) {
+        return old.type == entry->type && old.size == entry->size;
+        });
+    }
+
+    if (source != nullptr) changes.push_back({ Kind::Renamed, std::string(entry->path), std::string(source->path) });
+    else changes.push_back({ Kind::Added, std::string(entry->path), {} });
+  }
+
+  for (size_t k = 0; k < removed.size(); k++)
+  {
+    if (!renamed[k]) changes.push_back({ Kind::Removed, std::string(removed[k]->path), {} });
+  }
+
+  std::sort(changes.begin(), changes.end(), [](const SnapshotChange& a, const SnapshotChange& b) { return a.path < b.path; });
+  return changes;
+}
+
+void Toolkit::TreeSnapshot::SetPaths(const std::string& joined, const std::vector<uint32_t>& lengths)
+{
+  paths_ = std::make_unique<char[]>(joined.size() + 1);
+  std::memcpy(paths_.get(), joined.data(), joined.size());
+
+  size_t offset = 0;
+  for (size_t i = 0; i < entries_.size(); i++)
+  {
+    entries_[i].path = std::string_view(paths_.get() + offset, lengths[i]);
+    offset += lengths[i];
+  }
+}
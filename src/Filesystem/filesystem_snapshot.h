@@ -0,0 +1,76 @@
+#ifndef FILESYSTEM_SNAPSHOT_H
+#define FILESYSTEM_SNAPSHOT_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "filesystem_listing.h"
+
+namespace Toolkit {
+
+  struct SnapshotEntry {
+    std::string_view path;  // Relative to the root, '/' separated, owned by the snapshot
+    EntryType type;
+    uint64_t size = 0;
+    int64_t mtime = 0;      // Nanoseconds since the epoch
+    uint64_t inode = 0;     // 0 where the platform has none
+    uint64_t hash = 0;      // Content hash of regular files, see has_hash
+    bool has_hash = false;
+  };
+
+  struct SnapshotOptions {
+    bool hash_files = false;  // Reads every regular file
+    size_t thread_count = 0;  // 0 means one per hardware thread
+  };
+
+  struct SnapshotChange {
+    enum class Kind {
+      Added,
+      Removed,
+      Modified,  // Type, size, mtime or hash changed, directories only by type
+      Renamed,   // Same inode, size and mtime, or same content hash, under another path
+    };
+
+    Kind kind;
+    std::string path;
+    std::string old_path;  // Renamed only
+  };
+
+  /*
+   * Sorted manifest of a directory tree, captured with Filesystem::Walk() and
+   * a parallel stat of every entry. Symlinks are recorded, not followed.
+   * Saved as a compact binary file: paths are prefix-compressed against the
+   * previous one and numbers are varints. Snapshots can be moved, not copied.
+   */
+  class TreeSnapshot {
+  public:
+    TreeSnapshot() = default;
+
+    static TreeSnapshot Capture(const std::string& root, const SnapshotOptions& options = {});
+
+    bool Save(const std::string& file_path) const;
+    bool Load(const std::string& file_path);
+
+    const std::string& GetRoot() const;
+    const std::vector<SnapshotEntry>& GetEntries() const;
+
+    /* nullptr when there is no entry at path */
+    const SnapshotEntry* Find(std::string_view path) const;
+
+    /* Single merge of the two sorted manifests, changes are ordered by path */
+    static std::vector<SnapshotChange> Diff(const TreeSnapshot& before, const TreeSnapshot& after);
+
+  private:
+    /* Stores the paths of the entries, joined back to back in entry order */
+    void SetPaths(const std::string& joined, const std::vector<uint32_t>& lengths);
+
+    std::string root_;
+    std::unique_ptr<char[]> paths_;
+    std::vector<SnapshotEntry> entries_;
+  };
+}
+
+#endif // !FILESYSTEM_SNAPSHOT_H
@@ -0,0 +1,361 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#include "filesystem_ex.h"
+#include "filesystem_pool.h"
+
+namespace {
+  constexpr char kCacheMagic[4] = { 'T', 'K', 'D', 'U' };
+  constexpr uint32_t kCacheVersion = 1;
+
+  // Directories changed this recently may change again within the same mtime tick
+  constexpr int64_t kSettleTime = 2'000'000'000;
+
+  struct CachedDirectory {
+    int64_t mtime = 0;
+    Toolkit::UsageTotals own;
+    std::vector<std::string> children;
+  };
+
+  using UsageCache = std::unordered_map<std::string, CachedDirectory>;
+
+  struct UsageNode {
+    std::string path;
+    UsageNode* parent = nullptr;
+    CachedDirectory data;  // Subdirectory names are kept for the cache
+    Toolkit::UsageTotals total;
+    bool has_mtime = false;
+    std::vector<std::unique_ptr<UsageNode>> children;
+  };
+
+  struct UsageState {
+    const UsageCache& cache;
+    Toolkit::WorkStealingPool pool;
+    std::vector<Toolkit::DirectoryListing> listings;
+    std::atomic<size_t> scanned{ 0 };
+    std::atomic<size_t> cached{ 0 };
+
+    UsageState(const UsageCache& cache, size_t thread_count)
+      : cache{ cache }
+      , pool{ thread_count }
+      , listings(pool.GetThreadCount())
+    {
+    }
+  };
+
+  std::filesystem::path ToPath(const std::string& path)
+  {
+    return std::filesystem::path((const char8_t*)path.c_str());
+  }
+
+  std::string JoinPath(const std::string& dir, std::string_view name)
+  {
+    std::string path;
+    path.reserve(dir.size() + name.size() + 1);
+    path.append(dir);
+    if (path.empty() || path.back() != '/') path += '/';
+    path.append(name);
+    return path;
+  }
+
+  /* Time in the unit and epoch of the directory mtimes */
+  int64_t Now()
+  {
+#ifdef __linux__
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::file_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+  /* Size, blocks and mtime of the directory itself */
+  bool StatDirectory(UsageNode& node)
+  {
+    auto& own = node.data.own;
+    own.directories = 1;
+
+#ifdef __linux__
+    struct statx status;
+    if (statx(AT_FDCWD, node.path.c_str(), AT_STATX_DONT_SYNC, STATX_SIZE | STATX_BLOCKS | STATX_MTIME, &status) != 0) return false;
+
+    own.size = status.stx_size;
+    own.allocated = status.stx_blocks * 512;
+    node.data.mtime = status.stx_mtime.tv_sec * 1'000'000'000 + status.stx_mtime.tv_nsec;
+    return (status.stx_mask & STATX_MTIME) != 0;
+#else
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(ToPath(node.path), error);
+    if (error) return false;
+
+    node.data.mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    return true;
+#endif
+  }
+
+  /* Lists the directory, adding its entries to own and collecting its subdirectories.
+     False when it could not be listed in full. */
+  bool ListDirectory(UsageNode& node, Toolkit::DirectoryListing& listing)
+  {
+    using Toolkit::EntryType;
+
+    auto& own = node.data.own;
+    if (!listing.Open(node.path)) return false;
+
+    for (const auto& entry : listing)
+    {
+      if (entry.type == EntryType::Directory)
+      {
+        node.data.children.emplace_back(entry.name);
+        continue;
+      }
+
+      own.files++;
+
+#ifdef __linux__
+      // Only the two fields summed up, filesystems may skip gathering the rest
+      struct statx status;
+      int flags = AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC;
+      if (statx(listing.GetDescriptor(), entry.name.data(), flags, STATX_SIZE | STATX_BLOCKS, &status) == 0)
+      {
+        own.size += status.stx_size;
+        own.allocated += status.stx_blocks * 512;
+      }
+#else
+      std::error_code error;
+      auto size = std::filesystem::file_size(ToPath(JoinPath(node.path, entry.name)), error);
+      if (!error && entry.type == EntryType::File)
+      {
+        own.size += size;
+        own.allocated += size;
+      }
+#endif
+    }
+
+    bool listed = !listing.GetError();
+    listing.Close();
+    return listed;
+  }
+
+  void ScanDirectory(UsageState& state, UsageNode& node)
+  {
+    node.has_mtime = StatDirectory(node);
+
+    auto cached = node.has_mtime ? state.cache.find(node.path) : state.cache.end();
+    if (cached != state.cache.end() && cached->second.mtime == node.data.mtime)
+    {
+      node.data = cached->second;
+      state.cached++;
+    }
+    else
+    {
+      // An unreadable directory is not cached, a chmod would not change its mtime
+      if (ListDirectory(node, state.listings[state.pool.GetWorkerIndex()])) state.scanned++;
+      else node.has_mtime = false;
+    }
+
+    for (const auto& name : node.data.children)
+    {
+      auto child = std::make_unique<UsageNode>();
+      child->path = JoinPath(node.path, name);
+      child->parent = &node;
+
+      auto& child_node = *child;
+      node.children.push_back(std::move(child));
+      state.pool.Submit([&state, &child_node] { ScanDirectory(state, child_node); });
+    }
+  }
+
+  template<typename T>
+  void Write(std::ofstream& file, const T& value)
+  {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  void WriteString(std::ofstream& file, std::string_view value)
+  {
+    Write(file, static_cast<uint32_t>(value.size()));
+    file.write(value.data(), static_cast<std::streamsize>(value.size()));
+  }
+
+  template<typename T>
+  bool Read(std::ifstream& file, T& value)
+  {
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(value)));
+  }
+
+  bool ReadString(std::ifstream& file, std::string& value)
+  {
+    // Anything longer is a damaged file
+    uint32_t size = 0;
+    if (!Read(file, size) || size > 1024 * 1024) return false;
+
+    value.resize(size);
+    return static_cast<bool>(file.read(value.data(), size));
+  }
+
+  bool ReadTotals(std::ifstream& file, Toolkit::UsageTotals& totals)
+  {
+    return Read(file, totals.size) && Read(file, totals.allocated) && Read(file, totals.files) && Read(file, totals.directories);
+  }
+
+  /* Native byte order, a file written for another root or version is ignored */
+  UsageCache LoadCache(const std::string& cache_path, const std::string& root)
+  {
+    UsageCache cache;
+
+    std::ifstream file(ToPath(cache_path), std::ios::binary);
+    if (!file) return cache;
+
+    char magic[sizeof(kCacheMagic)];
+    uint32_t version = 0;
+    std::string cached_root;
+    uint64_t count = 0;
+
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, kCacheMagic, sizeof(magic)) != 0) return cache;
+    if (!Read(file, version) || version != kCacheVersion) return cache;
+    if (!ReadString(file, cached_root) || cached_root != root || !Read(file, count)) return cache;
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+      std::string path;
+      CachedDirectory directory;
+      uint32_t child_count = 0;
+
+      if (!ReadString(file, path) || !Read(file, directory.mtime) || !ReadTotals(file, directory.own) || !Read(file, child_count))
+      {
+        return {};
+      }
+
+      for (uint32_t j = 0; j < child_count; j++)
+      {
+        if (!ReadString(file, directory.children.emplace_back())) return {};
+      }
+
+      cache.emplace(std::move(path), std::move(directory));
+    }
+
+    return cache;
+  }
+
+  void SaveCache(const std::string& cache_path, const std::string& root, const std::vector<UsageNode*>& nodes)
+  {
+    // Only directories that cannot still be changing within their current mtime
+    int64_t settled = Now() - kSettleTime;
+
+    std::vector<const UsageNode*> saved;
+    for (auto node : nodes)
+    {
+      if (node->has_mtime && node->data.mtime < settled) saved.push_back(node);
+    }
+
+    // Written aside and renamed, so a reader never sees half a file
+    auto temporary = cache_path + ".tmp";
+    {
+      std::ofstream file(ToPath(temporary), std::ios::binary | std::ios::trunc);
+      if (!file) return;
+
+      file.write(kCacheMagic, sizeof(kCacheMagic));
+      Write(file, kCacheVersion);
+      WriteString(file, root);
+      Write(file, static_cast<uint64_t>(saved.size()));
+
+      for (auto node : saved)
+      {
+        const auto& own = node->data.own;
+
+        WriteString(file, node->path);
+        Write(file, node->data.mtime);
+        Write(file, own.size);
+        Write(file, own.allocated);
+        Write(file, own.files);
+        Write(file, own.directories);
+
+        Write(file, static_cast<uint32_t>(node->data.children.size()));
+        for (const auto& child : node->data.children) WriteString(file, child);
+      }
+
+      if (!file.flush()) return;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(ToPath(temporary), ToPath(cache_path), error);
+  }
+}
+
+Toolkit::UsageTotals& Toolkit::UsageTotals::operator+=(const UsageTotals& other)
+{
+  size += other.size;
+  allocated += other.allocated;
+  files += other.files;
+  directories += other.directories;
+  return *this;
+}
+
+const Toolkit::DirectoryUsage* Toolkit::DiskUsageReport::Find(const std::string& path) const
+{
+  auto found = std::lower_bound(directories.begin(), directories.end(), path, [](const DirectoryUsage& usage, const std::string& value) {
+    return usage.path < value;
+    });
+
+  return found != directories.end() && found->path == path ? &*found : nullptr;
+}
+
+Toolkit::DiskUsageReport Toolkit::Filesystem::DiskUsage(const std::string& root, const DiskUsageOptions& options)
+{
+  namespace fs = std::filesystem;
+
+  DiskUsageReport report;
+
+  std::error_code error;
+  if (!fs::is_directory(ToPath(root), error)) return report;
+
+  auto cache = options.cache_path.empty() ? UsageCache() : LoadCache(options.cache_path, root);
+
+  UsageNode root_node;
+  root_node.path = root;
+
+  {
+    UsageState state{ cache, options.thread_count };
+    state.pool.Submit([&state, &root_node] { ScanDirectory(state, root_node); });
+    state.pool.Wait();
+
+    report.scanned = state.scanned;
+    report.cached = state.cached;
+  }
+
+  // Parents come before their children, rolled up in reverse
+  std::vector<UsageNode*> nodes{ &root_node };
+  for (size_t i = 0; i < nodes.size(); i++)
+  {
+    for (const auto& child : nodes[i]->children) nodes.push_back(child.get());
+  }
+
+  for (auto node : nodes) node->total = node->data.own;
+  for (auto node = nodes.rbegin(); node != nodes.rend(); ++node)
+  {
+    if ((*node)->parent != nullptr) (*node)->parent->total += (*node)->total;
+  }
+
+  if (!options.cache_path.empty()) SaveCache(options.cache_path, root, nodes);
+
+  report.directories.reserve(nodes.size());
+  for (auto node : nodes) report.directories.push_back({ node->path, node->data.own, node->total });
+
+  std::sort(report.directories.begin(), report.directories.end(), [](const DirectoryUsage& a, const DirectoryUsage& b) {
+    return a.path < b.path;
+    });
+
+  return report;
+}
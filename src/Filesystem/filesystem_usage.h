@@ -0,0 +1,46 @@
+#ifndef FILESYSTEM_USAGE_H
+#define FILESYSTEM_USAGE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Toolkit {
+
+  /* A file with several hard links is counted, size included, once per link */
+  struct UsageTotals {
+    uint64_t size = 0;         // Apparent bytes
+    uint64_t allocated = 0;    // Bytes of the allocated blocks
+    uint64_t files = 0;        // Everything that is not a directory, symlinks are not followed
+    uint64_t directories = 0;
+
+    UsageTotals& operator+=(const UsageTotals& other);
+  };
+
+  struct DirectoryUsage {
+    std::string path;    // Generic UTF-8 path starting with the root
+    UsageTotals own;     // The directory itself and its direct entries
+    UsageTotals total;   // The whole subtree
+  };
+
+  struct DiskUsageOptions {
+    size_t thread_count = 0;  // 0 means one per hardware thread
+
+    /* File the per-directory results are loaded from and saved to, empty disables it.
+       A directory whose mtime did not change is neither listed nor are its entries
+       stat'ed again. Files rewritten in place do not change the mtime of their
+       directory, their new size shows once that directory changes. One file per root. */
+    std::string cache_path;
+  };
+
+  struct DiskUsageReport {
+    std::vector<DirectoryUsage> directories;  // Sorted by path, the root first, empty when root is not a directory
+    size_t scanned = 0;                       // Directories listed
+    size_t cached = 0;                        // Directories taken from the cache
+
+    /* nullptr when path was not part of the scan */
+    const DirectoryUsage* Find(const std::string& path) const;
+  };
+}
+
+#endif // !FILESYSTEM_USAGE_H
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#endif
+
+#include "filesystem_ex.h"
+#include "filesystem_pool.h"
+
+std::string_view Toolkit::WalkEntry::GetName() const
+{
+  std::string_view view = path;
+  auto separator = view.find_last_of('/');
+  return separator == std::string_view::npos ? view : view.substr(separator + 1);
+}
+
+struct Toolkit::Filesystem::WalkState {
+  const WalkOptions& options;
+  const WalkConsumer& consumer;
+  WorkStealingPool pool;
+
+  // Listing buffer, path buffer and pending batch per worker, batches go to the consumer when full
+  std::vector<DirectoryListing> listings;
+  std::vector<std::string> paths;
+  std::vector<std::vector<WalkEntry>> batches;
+  size_t root_size = 0;
+  std::mutex consumer_mutex;
+  std::atomic<bool> stopped{ false };
+
+  // Directories entered when following symlinks, by device and inode (canonical path elsewhere)
+  std::mutex visited_mutex;
+#ifdef __linux__
+  std::set<std::pair<uint64_t, uint64_t>> visited;
+#else
+  std::unordered_set<std::string> visited;
+#endif
+
+  WalkState(const WalkOptions& options, const WalkConsumer& consumer)
+    : options{ options }
+    , consumer{ consumer }
+    , pool{ options.thread_count }
+    , listings(pool.GetThreadCount())
+    , paths(pool.GetThreadCount())
+    , batches(pool.GetThreadCount())
+  {
+  }
+
+  /* False when the directory was already entered or cannot be identified */
+  bool Visit(const std::string& dir)
+  {
+#ifdef __linux__
+    struct stat status;
+    if (stat(dir.c_str(), &status) != 0) return false;
+
+    std::lock_guard lock{ visited_mutex };
+    return visited.emplace(static_cast<uint64_t>(status.st_dev), static_cast<uint64_t>(status.st_ino)).second;
+#else
+    std::error_code error;
+    auto canonical = std::filesystem::canonical(Utf8ToPath(dir), error);
+    if (error) return false;
+
+    std::lock_guard lock{ visited_mutex };
+    return visited.insert(PathToUtf8(canonical)).second;
+#endif
+  }
+};
+
+bool Toolkit::Filesystem::Walk(const std::string& root, const WalkOptions& options, const WalkConsumer& consumer)
+{
+  namespace fs = std::filesystem;
+
+  auto root_path = Utf8ToPath(root);
+
+  std::error_code error;
+  if (!fs::is_directory(root_path, error)) return false;
+
+  WalkState state{ options, consumer };
+  if (options.symlinks == WalkOptions::Symlinks::Follow) state.Visit(root);
+
+  if (options.max_depth > 0)
+  {
+    auto root_str = PathToUtf8(root_path);
+    state.root_size = root_str.size() + (root_str.ends_with('/') ? 0 : 1);
+
+    state.pool.Submit([&state, root_str] { WalkDirectory(state, root_str, 0); });
+    state.pool.Wait();
+  }
+
+  for (auto& batch : state.batches) FlushWalkBatch(state, batch);
+
+  return !state.stopped;
+}
+
+void Toolkit::Filesystem::WalkDirectory(WalkState& state, const std::string& dir, uint32_t depth)
+{
+  using Symlinks = WalkOptions::Symlinks;
+
+  const auto& options = state.options;
+  auto& listing = state.listings[state.pool.GetWorkerIndex()];
+  auto& path = state.paths[state.pool.GetWorkerIndex()];
+  auto& batch = state.batches[state.pool.GetWorkerIndex()];
+
+  if (!listing.Open(dir))
+  {
+    ReportWalkError(state, dir, listing.GetError());
+    return;
+  }
+
+  for (const auto& entry : listing)
+  {
+    if (state.stopped.load(std::memory_order_relaxed)) break;
+
+    bool is_symlink = entry.type == EntryType::Symlink;
+    if (is_symlink && options.symlinks == Symlinks::Skip) continue;
+
+    auto type = is_symlink && options.symlinks == Symlinks::Follow ? listing.GetTargetType(entry) : entry.type;
+
+    // Built in the reused worker buffer, names that are filtered out allocate nothing
+    path.assign(dir);
+    if (path.empty() || path.back() != '/') path += '/';
+    path.append(entry.name);
+
+    std::string_view relative = std::string_view(path).substr(std::min(state.root_size, path.size()));
+    bool report = options.pattern.Matches(relative);
+    bool enter = type == EntryType::Directory
+      && depth + 1 < options.max_depth
+      && options.pattern.CanMatchBelow(relative);
+
+    if (!report && !enter) continue;
+
+    WalkEntry walk_entry{ path, type, depth + 1 };
+
+    // Following links, every directory is recorded so one reached both ways is entered once
+    enter = enter
+      && !(options.prune && options.prune(walk_entry))
+      && !(options.symlinks == Symlinks::Follow && !state.Visit(walk_entry.path));
+
+    if (enter)
+    {
+      state.pool.Submit([&state, child = walk_entry.path, depth = walk_entry.depth] {
+        WalkDirectory(state, child, depth);
+        });
+    }
+
+    if (!report) continue;
+
+    batch.push_back(std::move(walk_entry));
+    if (batch.size() >= options.batch_size) FlushWalkBatch(state, batch);
+  }
+
+  if (listing.GetError()) ReportWalkError(state, dir, listing.GetError());
+  listing.Close();
+}
+
+void Toolkit::Filesystem::FlushWalkBatch(WalkState& state, std::vector<WalkEntry>& batch)
+{
+  if (batch.empty()) return;
+
+  {
+    std::lock_guard lock{ state.consumer_mutex };
+    if (!state.stopped && !state.consumer(batch)) state.stopped = true;
+  }
+
+  batch.clear();
+}
+
+void Toolkit::Filesystem::ReportWalkError(WalkState& state, const std::string& dir, std::error_code error)
+{
+  if (!state.options.on_error) return;
+
+  std::lock_guard lock{ state.consumer_mutex };
+  state.options.on_error(dir, error ? error : std::make_error_code(std::errc::io_error));
+}
@@ -4,104 +4,233 @@
 #include <string>
 #include <format>
 #include <chrono>
+#include <algorithm>
+#include <unordered_set>
+#include <unordered_map>
+#include <bit>
 
 #include "json.h"
+#include "json_hash.h"
 #include "json_parser.h"
 
 Json::Json()
-  : key_{ "" }
-  , parent_{ nullptr }
+  : parent_{ nullptr }
+  , key_{}
   , value_type_{ ValueType::Null }
+  , is_packed_{ false }
+  , is_integer_{ false }
+  , element_view_{ ElementView::None }
+  , hash_{ 0 }
 {
+  ConstructValue();
 }
 
-Json::Json(std::string key, Json* parent)
-  : key_{ key }
-  , parent_ { parent }
+Json::Json(std::string_view key, Json* parent)
+  : parent_ { parent }
+  , key_{ key }
   , value_type_{ ValueType::Null }
+  , is_packed_{ false }
+  , is_integer_{ false }
+  , element_view_{ ElementView::None }
+  , hash_{ 0 }
 {
-
+  ConstructValue();
 }
 
 Json::Json(const Json& obj)
 : parent_{ nullptr }
 , key_{obj.key_}
 , value_type_{obj.value_type_}
+, is_packed_{ false }
+, is_integer_{ false }
+, element_view_{ ElementView::None }
+, hash_{ obj.hash_.load(std::memory_order_relaxed) }
 {
-  if (std::holds_alternative<String>(obj.value_)) value_ = std::get<String>(obj.value_);
-  if (std::holds_alternative<Number>(obj.value_)) value_ = std::get<Number>(obj.value_);
-  if (std::holds_alternative<Bool>(obj.value_)) value_ = std::get<Bool>(obj.value_);
-
-  if (std::holds_alternative<ChildrenList>(obj.value_))
-  {
-    auto& objChildren = std::get<ChildrenList>(obj.value_);
-    
-    value_ = ChildrenList();
-    auto& copyChildren = std::get<ChildrenList>(value_);
-    copyChildren.reserve(objChildren.size());
-
-
-    for (auto& json : objChildren)
-    {
-      copyChildren.push_back(std::make_unique<Json>(*json));
-      copyChildren.back()->parent_ = this;
-    }
-  }
+  CopyValueFrom(obj);
 }
 
 Json::Json(Json&& obj) noexcept
-  : parent_{ nullptr }
-  , key_{ "" }
-  , value_type_{ ValueType::Undefined }
+  : parent_{ obj.parent_ }
+  , key_{ std::move(obj.key_) }
+  , value_type_{ obj.value_type_ }
+  , is_packed_{ false }
+  , is_integer_{ false }
+  , element_view_{ ElementView::None }
+  , hash_{ 0 }
 {
-  std::swap(parent_, obj.parent_);
-  std::swap(key_, obj.key_);
-  std::swap(value_type_, obj.value_type_);
-  std::swap(value_, obj.value_);
+  obj.InvalidateHash();
+  MoveValueFrom(obj);
+
+  obj.DestroyValue();
+  obj.parent_ = nullptr;
+  obj.value_type_ = ValueType::Undefined;
+  obj.ConstructValue();
 }
 
 Json& Json::operator=(const Json& obj)
 {
-  if (std::holds_alternative<String>(obj.value_)) value_ = std::get<String>(obj.value_);
-  if (std::holds_alternative<Number>(obj.value_)) value_ = std::get<Number>(obj.value_);
-  if (std::holds_alternative<Bool>(obj.value_)) value_ = std::get<Bool>(obj.value_);
+  if (this == &obj) return *this;
 
-  if (std::holds_alternative<ChildrenList>(obj.value_))
-  {
-    auto& objChildren = std::get<ChildrenList>(obj.value_);
-
-    value_ = ChildrenList();
-    auto& copyChildren = std::get<ChildrenList>(value_);
-    copyChildren.reserve(objChildren.size());
-
-    for (auto& json : objChildren)
-    {
-      copyChildren.push_back(std::make_unique<Json>(*json));
-      copyChildren.back()->parent_ = this;
-    }
-  }
+  InvalidateHash();
+  DestroyValue();
+  value_type_ = obj.value_type_;
+  CopyValueFrom(obj);
 
   return *this;
 }
 
 Json& Json::operator=(Json&& obj) noexcept
 {
+  if (this == &obj) return *this;
+
+  InvalidateHash();
+  obj.InvalidateHash();
+
   parent_ = obj.parent_;
-  key_ = obj.key_;
+  key_ = std::move(obj.key_);
+
+  DestroyValue();
   value_type_ = obj.value_type_;
+  MoveValueFrom(obj);
 
+  obj.DestroyValue();
   obj.parent_ = nullptr;
-  obj.key_ = "";
   obj.value_type_ = ValueType::Undefined;
-  value_ = std::move(obj.value_);
+  obj.ConstructValue();
 
   return *this;
 }
 
+Json::~Json()
+{
+  DestroyValue();
+}
+
+void* Json::operator new(size_t size)
+{
+  return JsonAllocator::AllocateOwned(size, alignof(Json));
+}
+
+void Json::operator delete(void* ptr, size_t size)
+{
+  JsonAllocator::DeallocateOwned(ptr, size, alignof(Json));
+}
+
+void Json::ConstructValue()
+{
+  is_packed_ = false;
+  is_integer_ = false;
+
+  switch (value_type_)
+  {
+  case ValueType::String:
+    new (&string_) JsonString();
+    break;
+  case ValueType::Object:
+  case ValueType::Array:
+    new (&children_) ChildrenList();
+    break;
+  case ValueType::Bool:
+    bool_ = false;
+    break;
+  default:
+    number_ = 0;
+    break;
+  }
+}
+
+void Json::DestroyValue()
+{
+  switch (value_type_)
+  {
+  case ValueType::String:
+    string_.~JsonString();
+    break;
+  case ValueType::Object:
+  case ValueType::Array:
+    if (is_packed_) packed_.~unique_ptr();
+    else children_.~ChildrenList();
+    break;
+  default:
+    break;
+  }
+  is_packed_ = false;
+}
+
+void Json::CopyValueFrom(const Json& obj)
+{
+  switch (value_type_)
+  {
+  case ValueType::String:
+    new (&string_) JsonString(obj.string_);
+    break;
+
+  case ValueType::Object:
+  case ValueType::Array:
+    if (obj.is_packed_)
+    {
+      new (&packed_) std::unique_ptr<JsonPackedArray>(std::make_unique<JsonPackedArray>(*obj.packed_));
+      is_packed_ = true;
+      break;
+    }
+
+    new (&children_) ChildrenList();
+    children_.reserve(obj.children_.size());
+
+    for (auto& json : obj.children_)
+    {
+      children_.push_back(std::make_unique<Json>(*json));
+      children_.back()->parent_ = this;
+    }
+    break;
+
+  case ValueType::Bool:
+    bool_ = obj.bool_;
+    break;
+
+  default:
+    number_ = obj.number_;
+    is_integer_ = obj.is_integer_;
+    break;
+  }
+}
+
+void Json::MoveValueFrom(Json& obj)
+{
+  switch (value_type_)
+  {
+  case ValueType::String:
+    new (&string_) JsonString(std::move(obj.string_));
+    break;
+
+  case ValueType::Object:
+  case ValueType::Array:
+    if (obj.is_packed_)
+    {
+      new (&packed_) std::unique_ptr<JsonPackedArray>(std::move(obj.packed_));
+      is_packed_ = true;
+      break;
+    }
+
+    new (&children_) ChildrenList(std::move(obj.children_));
+    for (auto& child : children_) child->parent_ = this;
+    break;
+
+  case ValueType::Bool:
+    bool_ = obj.bool_;
+    break;
+
+  default:
+    number_ = obj.number_;
+    is_integer_ = obj.is_integer_;
+    break;
+  }
+}
+
 
 std::unique_ptr<Json> Json::Parse(const std::string& data, ProgresCallback progress_callback)
 {
-  JsonParser parser;
+  thread_local JsonParser parser;
   return parser.Parse(data, progress_callback);
 }
 
@@ -109,39 +238,143 @@ std::unique_ptr<Json> Json::Parse(const std::string& data, ProgresCallback progr
 bool Json::SetKey(std::string key)
 {
   auto parent = this->GetParent();
-  bool key_exists = false;
 
-  if (std::holds_alternative<ChildrenList>(parent->value_))
+  if (parent != nullptr && parent->IsContainer())
   {
-    auto& children = std::get<ChildrenList>(parent->value_);
-
-    for (auto& child : children) {
+    for (auto& child : parent->children_) {
       if (child->GetKey() == key) return false;
     }
-
   }
-  key_ = key_exists ? key_ : key;
+
+  key_.Assign(key);
+  if (parent_ != nullptr) parent_->InvalidateHash();
   return true;
 }
 
 void Json::SetType(ValueType type)
 {
+  InvalidateHash();
+
+  bool keep_children = IsContainer() && (type == ValueType::Object || type == ValueType::Array);
+
+  if (!keep_children && type != value_type_)
+  {
+    DestroyValue();
+    value_type_ = type;
+    ConstructValue();
+  }
+
   value_type_ = type;
 }
 
+bool Json::IsContainer() const
+{
+  return (value_type_ == ValueType::Object || value_type_ == ValueType::Array) && !is_packed_;
+}
+
+void Json::StartPacked(JsonPackedArray::ElementType type)
+{
+  SetType(ValueType::Array);
+  DestroyValue();
+  new (&packed_) std::unique_ptr<JsonPackedArray>(std::make_unique<JsonPackedArray>(type));
+  is_packed_ = true;
+}
+
+bool Json::IsPacked() const
+{
+  return is_packed_;
+}
+
+bool Json::Pack()
+{
+  using ElementType = JsonPackedArray::ElementType;
+
+  if (is_packed_) return true;
+  if (value_type_ != ValueType::Array || children_.empty()) return false;
+
+  auto element_type = children_.front()->GetType();
+  if (element_type != ValueType::Number && element_type != ValueType::Bool) return false;
+
+  for (auto& child : children_)
+  {
+    if (child->GetType() != element_type) return false;
+  }
+
+  // Integer only when every number was written as one, like the parser packs them
+  auto packed_type = element_type == ValueType::Bool ? ElementType::Bool : ElementType::Number;
+  if (packed_type == ElementType::Number && std::all_of(children_.begin(), children_.end(), [](auto& child) { return child->is_integer_; }))
+  {
+    packed_type = ElementType::Integer;
+  }
+
+  auto packed = std::make_unique<JsonPackedArray>(packed_type);
+  packed->Reserve(children_.size());
+
+  for (auto& child : children_)
+  {
+    if (packed_type == ElementType::Bool) packed->AppendBool(child->bool_);
+    else if (packed_type == ElementType::Integer) packed->AppendInteger(static_cast<int64_t>(child->number_));
+    else packed->AppendNumber(child->number_);
+  }
+
+  DestroyValue();
+  new (&packed_) std::unique_ptr<JsonPackedArray>(std::move(packed));
+  is_packed_ = true;
+
+  return true;
+}
+
+void Json::Unpack()
+{
+  if (!is_packed_) return;
+
+  // The new element nodes start without a hash
+  InvalidateHash();
+
+  auto packed = std::move(packed_);
+  DestroyValue();
+  new (&children_) ChildrenList();
+  children_.reserve(packed->Size());
+
+  bool is_integer = packed->GetElementType() == JsonPackedArray::ElementType::Integer;
+  auto integers = packed->GetIntegers();
+
+  for (size_t i = 0; i < packed->Size(); i++)
+  {
+    children_.push_back(std::make_unique<Json>("", this));
+    if (is_integer) children_.back()->SetValue(integers[i]);
+    else if (packed->IsNumeric()) children_.back()->SetValue(packed->NumberAt(i));
+    else children_.back()->SetValue(packed->BoolAt(i));
+  }
+}
+
+std::span<const Number> Json::GetNumbers() const
+{
+  if (!is_packed_) return {};
+  return packed_->GetNumbers();
+}
+
+std::span<const int64_t> Json::GetIntegers() const
+{
+  if (!is_packed_) return {};
+  return packed_->GetIntegers();
+}
+
+std::span<const uint8_t> Json::GetBools() const
+{
+  if (!is_packed_) return {};
+  return packed_->GetBools();
+}
+
 void Json::ConvertToArray()
 {
   std::unique_ptr<Json> copy = std::make_unique<Json>(std::move(*this));
   this->SetType(ValueType::Array);
-  this->key_ = copy->key_;
+  this->key_ = std::move(copy->key_);
   this->parent_ = copy->parent_;
 
-  copy->key_ = "";
   copy->SetParent(this);
-  this->value_ = ChildrenList();
-  auto& children = std::get<ChildrenList>(value_);
-
-  children.push_back(std::move(copy));
+  children_.push_back(std::move(copy));
 }
 
 void Json::ToString(std::string& str) const
@@ -151,7 +384,7 @@ void Json::ToString(std::string& str) const
   {
   case Json::ValueType::String:
     {
-      auto& value = std::get<String>(value_);
+      auto value = string_.View();
 
       if (IsArrayElement())
       {
@@ -159,14 +392,14 @@ void Json::ToString(std::string& str) const
       }
       else
       {
-        str += std::format("\"{}\":\"{}\"", key_, value);
+        str += std::format("\"{}\":\"{}\"", key_.View(), value);
       }
     }
     break;
 
   case Json::ValueType::Number:
     {
-      auto& value = std::get<Number>(value_);
+      auto value = number_;
 
       if (IsArrayElement())
       {
@@ -174,14 +407,14 @@ void Json::ToString(std::string& str) const
       }
       else
       {
-        str += std::format("\"{}\":{}", key_, std::to_string(value));
+        str += std::format("\"{}\":{}", key_.View(), std::to_string(value));
       }
     }
     break;
 
   case Json::ValueType::Bool:
     {
-      auto& value = std::get<Bool>(value_);
+      auto value = bool_;
 
       if (IsArrayElement())
       {
@@ -190,7 +423,7 @@ void Json::ToString(std::string& str) const
       else
       {
         std::string bool_value = value == true ? "true" : "false";
-        str += std::format("\"{}\":{}", key_, bool_value);
+        str += std::format("\"{}\":{}", key_.View(), bool_value);
       }
     }
     break;
@@ -203,12 +436,15 @@ void Json::ToString(std::string& str) const
       }
       else
       {
-        str += std::format("\"{}\":{{", key_);
+        str += std::format("\"{}\":{{", key_.View());
       }
       
-      ForEachChild([&str](const Json& child) -> void {
+      // Separators do not rely on parent links, deduplicated subtrees have several parents
+      bool first = true;
+      ForEachChild([&str, &first](const Json& child) -> void {
+        if (!first) str.append(1, ',');
+        first = false;
         child.ToString(str);
-        if (!child.IsLastChild()) str.append(1, ',');
         });
       str.append(1, '}');
     }
@@ -222,13 +458,30 @@ void Json::ToString(std::string& str) const
     }
     else
     {
-      str += std::format("\"{}\":[", key_);
+      str += std::format("\"{}\":[", key_.View());
+    }
+
+    if (is_packed_)
+    {
+      for (size_t i = 0; i < packed_->Size(); i++)
+      {
+        if (i != 0) str.append(1, ',');
+
+        if (packed_->IsNumeric()) str += std::to_string(packed_->NumberAt(i));
+        else str += packed_->BoolAt(i) ? "true" : "false";
+      }
+      str.append(1, ']');
+      break;
     }
 
-    ForEachChild([&str](const Json& child) -> void {
-      child.ToString(str);
-      if (!child.IsLastChild()) str.append(1, ',');
-      });
+    {
+      bool first = true;
+      ForEachChild([&str, &first](const Json& child) -> void {
+        if (!first) str.append(1, ',');
+        first = false;
+        child.ToString(str);
+        });
+    }
     str.append(1, ']');
     break;
 
@@ -240,7 +493,7 @@ void Json::ToString(std::string& str) const
     }
     else
     {
-      str += std::format("\"{}\":null", key_);
+      str += std::format("\"{}\":null", key_.View());
     }
   }
     break;
@@ -256,9 +509,9 @@ Json::ValueType Json::GetType() const
   return value_type_;
 }
 
-const std::string& Json::GetKey() const
+std::string_view Json::GetKey() const
 {
-  return key_;
+  return key_.View();
 }
 
 Json* Json::GetParent() const
@@ -266,9 +519,18 @@ Json* Json::GetParent() const
   return parent_;
 }
 
-const JsonValue& Json::GetValue() const
+JsonValue Json::GetValue() const
 {
-  return value_;
+  switch (value_type_)
+  {
+  case ValueType::String:   return string_.View();
+  case ValueType::Number:   return number_;
+  case ValueType::Bool:     return bool_;
+  case ValueType::Object:
+  case ValueType::Array:    if (is_packed_) return packed_.get();
+                            return &children_;
+  default:                  return std::monostate();
+  }
 }
 
 void Json::SetParent(Json* parent)
@@ -278,14 +540,13 @@ void Json::SetParent(Json* parent)
 
 void Json::SetValue(bool data)
 {
-  value_ = data;
-  value_type_ = ValueType::Bool;
+  SetType(ValueType::Bool);
+  bool_ = data;
 }
 
 void Json::ClearValue()
 {
-  value_ = JsonValue();
-  value_type_ = ValueType::Null;
+  SetType(ValueType::Null);
 }
 
 std::unique_ptr<Json> Json::Detach()
@@ -295,12 +556,11 @@ std::unique_ptr<Json> Json::Detach()
   std::unique_ptr<Json> json;
 
   auto parent = this->GetParent();
+  parent->InvalidateHash();
 
-  auto& value = parent->value_;
-
-  if (std::holds_alternative<ChildrenList>(value))
+  if (parent->IsContainer())
   {
-    auto& children = std::get<ChildrenList>(value);
+    auto& children = parent->children_;
 
     for (auto it = std::begin(children); it != std::end(children); it++)
     {
@@ -318,14 +578,236 @@ std::unique_ptr<Json> Json::Detach()
 
 bool Json::RemoveChild(int index)
 {
-  if (!std::holds_alternative<ChildrenList>(value_)) return false;
+  if (is_packed_) Unpack();
+  if (!IsContainer()) return false;
 
-  auto& children = std::get<ChildrenList>(value_);
-  children.erase(std::begin(children) + index);
+  InvalidateHash();
+  children_.erase(std::begin(children_) + index);
 
   return true;
 }
 
+size_t Json::RemoveChildren(std::span<const int> indices)
+{
+  size_t size = 0;
+  ForEachChild([&size](const Json&) { size++; });
+
+  std::vector<uint8_t> remove_mask(size, 0);
+  for (auto index : indices)
+  {
+    if (index >= 0 && static_cast<size_t>(index) < size) remove_mask[index] = 1;
+  }
+
+  return CompactChildren(remove_mask, nullptr);
+}
+
+ChildrenList Json::DetachChildren(std::span<Json* const> nodes)
+{
+  ChildrenList detached;
+  if (!IsContainer()) return detached;
+
+  std::unordered_set<const Json*> selected(nodes.begin(), nodes.end());
+
+  std::vector<uint8_t> remove_mask;
+  remove_mask.reserve(children_.size());
+  for (auto& child : children_)
+  {
+    remove_mask.push_back(selected.contains(child.get()) ? 1 : 0);
+  }
+
+  CompactChildren(remove_mask, &detached);
+  return detached;
+}
+
+size_t Json::CompactChildren(std::span<const uint8_t> remove_mask, ChildrenList* detached)
+{
+  bool any_removed = std::find(remove_mask.begin(), remove_mask.end(), 1) != remove_mask.end();
+  if (!any_removed) return 0;
+
+  InvalidateHash();
+
+  if (is_packed_)
+  {
+    if (detached == nullptr) return packed_->Compact(remove_mask);
+
+    // Detached elements have to be real nodes
+    Unpack();
+  }
+
+  if (!IsContainer()) return 0;
+
+  size_t kept = 0;
+  size_t removed = 0;
+
+  for (size_t i = 0; i < children_.size(); i++)
+  {
+    if (i < remove_mask.size() && remove_mask[i])
+    {
+      children_[i]->parent_ = nullptr;
+      if (detached != nullptr) detached->push_back(std::move(children_[i]));
+      else children_[i].reset();
+
+      removed++;
+      continue;
+    }
+
+    if (kept != i) children_[kept] = std::move(children_[i]);
+    kept++;
+  }
+
+  children_.erase(children_.begin() + kept, children_.end());
+  return removed;
+}
+
+Json& Json::MergeFrom(Json&& other)
+{
+  return MergeFrom(std::move(other), MergePolicy());
+}
+
+Json& Json::MergeFrom(Json&& other, const MergePolicy& policy)
+{
+  if (this == &other) return *this;
+
+  InvalidateHash();
+  other.InvalidateHash();
+
+  bool objects = value_type_ == ValueType::Object && other.value_type_ == ValueType::Object;
+  bool arrays = value_type_ == ValueType::Array && other.value_type_ == ValueType::Array;
+
+  if (objects && policy.objects == MergePolicy::Objects::Recurse)
+  {
+    MergeObject(other, policy);
+  }
+  else if (arrays && policy.arrays == MergePolicy::Arrays::Append)
+  {
+    AppendArray(other);
+  }
+  else
+  {
+    TakeValue(other);
+  }
+
+  return *this;
+}
+
+void Json::MergeObject(Json& other, const MergePolicy& policy)
+{
+  constexpr size_t npos = static_cast<size_t>(-1);
+
+  // Hash the target keys once when a scan per override key would cost more.
+  // Matched members are merged in place, so the indexed key views stay valid.
+  constexpr size_t kIndexThreshold = 8;
+  bool use_index = other.children_.size() > kIndexThreshold;
+
+  std::unordered_map<std::string_view, size_t> index;
+  if (use_index)
+  {
+    index.reserve(children_.size() + other.children_.size());
+    for (size_t i = 0; i < children_.size(); i++)
+    {
+      index.try_emplace(children_[i]->key_.View(), i);
+    }
+  }
+
+  auto find = [&](std::string_view key) {
+    if (use_index)
+    {
+      auto it = index.find(key);
+      return it != index.end() ? it->second : npos;
+    }
+
+    for (size_t i = 0; i < children_.size(); i++)
+    {
+      if (children_[i]->key_ == key) return i;
+    }
+    return npos;
+  };
+
+  std::vector<uint8_t> remove_mask;
+
+  for (auto& source : other.children_)
+  {
+    size_t position = find(source->key_.View());
+    bool deletes = policy.null_deletes && source->value_type_ == ValueType::Null;
+
+    if (position == npos)
+    {
+      if (deletes) continue;
+
+      source->parent_ = this;
+      children_.push_back(std::move(source));
+      if (use_index) index.try_emplace(children_.back()->key_.View(), children_.size() - 1);
+      continue;
+    }
+
+    if (remove_mask.size() < children_.size()) remove_mask.resize(children_.size());
+
+    if (deletes)
+    {
+      remove_mask[position] = 1;
+      continue;
+    }
+
+    remove_mask[position] = 0;
+    children_[position]->MergeFrom(std::move(*source), policy);
+  }
+
+  other.SetType(ValueType::Undefined);
+
+  if (!remove_mask.empty()) CompactChildren(remove_mask, nullptr);
+}
+
+void Json::AppendArray(Json& other)
+{
+  if (!is_packed_ && children_.empty())
+  {
+    TakeValue(other);
+    return;
+  }
+
+  if (is_packed_ && other.is_packed_ && packed_->IsNumeric() == other.packed_->IsNumeric())
+  {
+    auto& source = *other.packed_;
+    packed_->Reserve(packed_->Size() + source.Size());
+
+    switch (source.GetElementType())
+    {
+    case JsonPackedArray::ElementType::Integer:
+      for (auto value : source.GetIntegers()) packed_->AppendInteger(value);
+      break;
+    case JsonPackedArray::ElementType::Number:
+      for (auto value : source.GetNumbers()) packed_->AppendNumber(value);
+      break;
+    default:
+      for (auto value : source.GetBools()) packed_->AppendBool(value != 0);
+      break;
+    }
+  }
+  else
+  {
+    Unpack();
+    other.Unpack();
+
+    children_.reserve(children_.size() + other.children_.size());
+    for (auto& child : other.children_)
+    {
+      child->parent_ = this;
+      children_.push_back(std::move(child));
+    }
+  }
+
+  other.SetType(ValueType::Undefined);
+}
+
+void Json::TakeValue(Json& other)
+{
+  DestroyValue();
+  value_type_ = other.value_type_;
+  MoveValueFrom(other);
+
+  other.SetType(ValueType::Undefined);
+}
+
 bool Json::IsValid() const
 {
   return value_type_ == ValueType::Undefined ? false : true;
@@ -338,14 +820,15 @@ bool Json::IsRoot() const
 
 bool Json::IsArrayElement() const
 {
+  if (element_view_ != ElementView::None) return true;
   if (parent_ == nullptr) return false;
   return parent_->GetType() == ValueType::Array;
 }
 
 bool Json::IsLastChild() const
 {
-  auto& parents_value = std::get<ChildrenList>(parent_->value_);
-  return parents_value.back().get() == this;
+  if (element_view_ != ElementView::None) return element_view_ == ElementView::Last;
+  return parent_->children_.back().get() == this;
 }
 
 Json* Json::GetRoot()
@@ -362,9 +845,8 @@ Json* Json::GetRoot()
 Json* Json::operator[](std::string_view key)
 {
   if (value_type_ != ValueType::Object) return nullptr;
-  if (!std::holds_alternative<ChildrenList>(value_)) return nullptr;
 
-  for (auto& child : std::get<ChildrenList>(value_))
+  for (auto& child : children_)
   {
     if (child->GetKey() == key) return child.get();
   }
@@ -374,23 +856,69 @@ Json* Json::operator[](std::string_view key)
 
 Json* Json::operator[](int index)
 {
-  if (value_type_ != ValueType::Object && value_type_ != ValueType::Array) return nullptr;
-  if (!std::holds_alternative<ChildrenList>(value_)) return nullptr;
+  if (is_packed_) Unpack();
+  if (!IsContainer()) return nullptr;
+
+  return children_[index].get();
+}
+
+const Json* Json::operator[](std::string_view key) const
+{
+  if (value_type_ != ValueType::Object) return nullptr;
 
+  for (auto& child : children_)
+  {
+    if (child->GetKey() == key) return child.get();
+  }
+
+  return nullptr;
+}
 
+const Json* Json::operator[](int index) const
+{
+  if (!IsContainer()) return nullptr;
+  if (index < 0 || static_cast<size_t>(index) >= children_.size()) return nullptr;
 
-  return std::get<ChildrenList>(value_)[index].get();
+  return children_[index].get();
 }
 
 void Json::ForEachChild(const std::function<void(const Json&)>& function) const
 {
-  if (std::holds_alternative<ChildrenList>(value_))
+  VisitChildren([&function](const Json& child, size_t) { function(child); });
+}
+
+void Json::ForEachChild(const std::function<void(const Json&, size_t index)>& function) const
+{
+  VisitChildren(function);
+}
+
+template<typename F>
+void Json::VisitChildren(const F& function) const
+{
+  if (is_packed_)
   {
-    auto& children = std::get<ChildrenList>(value_);
+    Json element;
 
-    for (auto& element : children)
+    bool is_integer = packed_->GetElementType() == JsonPackedArray::ElementType::Integer;
+    auto integers = packed_->GetIntegers();
+
+    for (size_t i = 0; i < packed_->Size(); i++)
     {
-      function(*element);
+      if (is_integer) element.SetValue(integers[i]);
+      else if (packed_->IsNumeric()) element.SetValue(packed_->NumberAt(i));
+      else element.SetValue(packed_->BoolAt(i));
+
+      element.element_view_ = i + 1 == packed_->Size() ? ElementView::Last : ElementView::Element;
+      function(element, i);
+    }
+    return;
+  }
+
+  if (IsContainer())
+  {
+    for (size_t i = 0; i < children_.size(); i++)
+    {
+      function(*children_[i], i);
     }
   }
 }
@@ -404,3 +932,286 @@ std::string Json::ToString() const
   return json_string;
 }
 
+size_t Json::Footprint::Total() const
+{
+  return nodes + keys + strings + children + packed_arrays;
+}
+
+Json::Footprint Json::MemoryFootprint() const
+{
+  Footprint footprint;
+  MemoryFootprint(footprint);
+  return footprint;
+}
+
+void Json::MemoryFootprint(Footprint& footprint) const
+{
+  footprint.node_count++;
+  footprint.nodes += sizeof(Json);
+  footprint.keys += key_.HeapBytes();
+
+  switch (value_type_)
+  {
+  case ValueType::String:
+    footprint.strings += string_.HeapBytes();
+    break;
+
+  case ValueType::Object:
+  case ValueType::Array:
+    if (is_packed_)
+    {
+      footprint.packed_arrays += packed_->HeapBytes();
+      break;
+    }
+
+    footprint.children += children_.capacity() * sizeof(ChildrenList::value_type);
+    for (auto& child : children_)
+    {
+      child->MemoryFootprint(footprint);
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+uint64_t Json::Hash() const
+{
+  uint64_t hash = hash_.load(std::memory_order_relaxed);
+  if (hash != 0) return hash;
+
+  // Racing readers of a frozen document compute and store the same value
+  hash = ComputeHash();
+  if (hash == 0) hash = 1;
+
+  hash_.store(hash, std::memory_order_relaxed);
+  return hash;
+}
+
+namespace {
+  uint64_t HashNumber(Number value)
+  {
+    if (value == 0) value = 0;  // -0.0 and 0.0 compare equal
+    return JsonHashMix(static_cast<uint64_t>(Json::ValueType::Number), std::bit_cast<uint64_t>(value));
+  }
+
+  uint64_t HashBool(bool value)
+  {
+    return JsonHashMix(static_cast<uint64_t>(Json::ValueType::Bool), value ? 1 : 0);
+  }
+}
+
+uint64_t Json::ComputeHash() const
+{
+  auto type = static_cast<uint64_t>(static_cast<uint8_t>(value_type_));
+
+  switch (value_type_)
+  {
+  case ValueType::String:
+    return JsonHashBytes(string_.Data(), string_.Size(), type);
+
+  case ValueType::Number:
+    return HashNumber(number_);
+
+  case ValueType::Bool:
+    return HashBool(bool_);
+
+  case ValueType::Array:
+  {
+    uint64_t hash = type;
+
+    // Packed elements hash like the nodes Unpack() would create
+    if (is_packed_)
+    {
+      for (size_t i = 0; i < packed_->Size(); i++)
+      {
+        hash = JsonHashMix(hash, packed_->IsNumeric() ? HashNumber(packed_->NumberAt(i)) : HashBool(packed_->BoolAt(i)));
+      }
+      return hash;
+    }
+
+    for (auto& child : children_) hash = JsonHashMix(hash, child->Hash());
+    return hash;
+  }
+
+  case ValueType::Object:
+  {
+    uint64_t hash = type;
+    for (auto& child : children_)
+    {
+      auto key = child->key_.View();
+      hash = JsonHashMix(hash, JsonHashMix(JsonHashBytes(key.data(), key.size()), child->Hash()));
+    }
+    return hash;
+  }
+
+  default:
+    return JsonHashMix(type, 0);
+  }
+}
+
+void Json::InvalidateHash()
+{
+  for (Json* node = this; node != nullptr; node = node->parent_)
+  {
+    if (node->hash_.load(std::memory_order_relaxed) == 0) break;
+    node->hash_.store(0, std::memory_order_relaxed);
+  }
+}
+
+FrozenJson Json::Freeze() const
+{
+  return Freeze(std::make_unique<Json>(*this));
+}
+
+FrozenJson Json::Freeze(std::unique_ptr<Json> json)
+{
+  if (json == nullptr) return FrozenJson();
+
+  json->parent_ = nullptr;
+  json->ShrinkToFit();
+
+  return FrozenJson(std::move(json));
+}
+
+struct Json::DeduplicationState {
+  // Canonical nodes by hash of key, subtree and parent type
+  std::unordered_multimap<uint64_t, Json*> nodes;
+  std::unordered_map<std::string_view, const JsonString*> strings;
+
+  // Child slots pointing at a canonical node they do not own
+  std::vector<std::unique_ptr<Json>*> aliases;
+};
+
+FrozenJson Json::FreezeDeduplicated(std::unique_ptr<Json> json)
+{
+  if (json == nullptr) return FrozenJson();
+
+  json->parent_ = nullptr;
+  json->ShrinkToFit();
+
+  DeduplicationState state;
+  json->Deduplicate(state);
+
+  // Aliases are released first, every canonical node is then deleted once by its owner
+  return FrozenJson(json.release(), [aliases = std::move(state.aliases)](const Json* root) {
+    for (auto slot : aliases) slot->release();
+    delete root;
+    });
+}
+
+FrozenJson Json::ParseDeduplicated(const std::string& data)
+{
+  return FreezeDeduplicated(Parse(data));
+}
+
+void Json::Deduplicate(DeduplicationState& state)
+{
+  ShareStrings(state);
+
+  if (!IsContainer()) return;
+
+  auto parent_type = static_cast<uint64_t>(static_cast<uint8_t>(value_type_));
+
+  for (auto& slot : children_)
+  {
+    auto key = slot->key_.View();
+    uint64_t group = JsonHashMix(JsonHashMix(slot->Hash(), JsonHashBytes(key.data(), key.size())), parent_type);
+
+    Json* canonical = nullptr;
+    auto [first, last] = state.nodes.equal_range(group);
+    for (auto it = first; it != last && canonical == nullptr; ++it)
+    {
+      if (it->second->Equals(*slot)) canonical = it->second;
+    }
+
+    if (canonical != nullptr)
+    {
+      slot.reset(canonical);
+      state.aliases.push_back(&slot);
+      continue;
+    }
+
+    state.nodes.emplace(group, slot.get());
+    slot->Deduplicate(state);
+  }
+}
+
+void Json::ShareStrings(DeduplicationState& state)
+{
+  auto share = [&state](JsonString& str) {
+    if (str.IsInline()) return;
+
+    auto [it, inserted] = state.strings.try_emplace(str.View(), &str);
+    if (!inserted) str.Share(*it->second);
+    };
+
+  share(key_);
+  if (value_type_ == ValueType::String) share(string_);
+}
+
+bool Json::Equals(const Json& other) const
+{
+  if (this == &other) return true;
+
+  if (value_type_ != other.value_type_ || is_packed_ != other.is_packed_) return false;
+  if (key_.View() != other.key_.View() || Hash() != other.Hash()) return false;
+
+  switch (value_type_)
+  {
+  case ValueType::String:
+    return string_.View() == other.string_.View();
+
+  case ValueType::Number:
+    // Bitwise, so 0 and -0 stay distinct and print as they were parsed
+    return std::bit_cast<uint64_t>(number_) == std::bit_cast<uint64_t>(other.number_);
+
+  case ValueType::Bool:
+    return bool_ == other.bool_;
+
+  case ValueType::Object:
+  case ValueType::Array:
+    if (is_packed_)
+    {
+      if (packed_->IsNumeric() != other.packed_->IsNumeric() || packed_->Size() != other.packed_->Size()) return false;
+
+      for (size_t i = 0; i < packed_->Size(); i++)
+      {
+        bool same = packed_->IsNumeric()
+          ? std::bit_cast<uint64_t>(packed_->NumberAt(i)) == std::bit_cast<uint64_t>(other.packed_->NumberAt(i))
+          : packed_->BoolAt(i) == other.packed_->BoolAt(i);
+        if (!same) return false;
+      }
+      return true;
+    }
+
+    if (children_.size() != other.children_.size()) return false;
+
+    for (size_t i = 0; i < children_.size(); i++)
+    {
+      if (!children_[i]->Equals(*other.children_[i])) return false;
+    }
+    return true;
+
+  default:
+    return true;
+  }
+}
+
+void Json::ShrinkToFit()
+{
+  if (is_packed_)
+  {
+    packed_->ShrinkToFit();
+    return;
+  }
+
+  if (!IsContainer()) return;
+
+  children_.shrink_to_fit();
+  for (auto& child : children_)
+  {
+    child->ShrinkToFit();
+  }
+}
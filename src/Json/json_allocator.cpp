@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cstring>
+
+#include "json_allocator.h"
+
+namespace {
+
+  class DefaultAllocator : public JsonAllocator {
+  public:
+    void* Allocate(size_t size, size_t alignment) override
+    {
+      if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+      {
+        return ::operator new(size, std::align_val_t(alignment));
+      }
+      return ::operator new(size);
+    }
+
+    void Deallocate(void* ptr, size_t size, size_t alignment) override
+    {
+      if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+      {
+        ::operator delete(ptr, size, std::align_val_t(alignment));
+        return;
+      }
+      ::operator delete(ptr, size);
+    }
+  };
+}
+
+JsonAllocator& JsonAllocator::GetOwner()
+{
+  return *this;
+}
+
+void* JsonAllocator::AllocateOwned(size_t size, size_t alignment)
+{
+  JsonAllocator& allocator = Current();
+  JsonAllocator* owner = &allocator.GetOwner();
+
+  size_t header_size = GetHeaderSize(alignment);
+  auto block = static_cast<std::byte*>(allocator.Allocate(size + header_size, std::max(alignment, alignof(JsonAllocator*))));
+  std::memcpy(block, &owner, sizeof(owner));
+  return block + header_size;
+}
+
+void JsonAllocator::DeallocateOwned(void* ptr, size_t size, size_t alignment)
+{
+  size_t header_size = GetHeaderSize(alignment);
+  auto block = static_cast<std::byte*>(ptr) - header_size;
+
+  JsonAllocator* owner = nullptr;
+  std::memcpy(&owner, block, sizeof(owner));
+
+  JsonAllocator& current = Current();
+  JsonAllocator& allocator = &current.GetOwner() == owner ? current : *owner;
+  allocator.Deallocate(block, size + header_size, std::max(alignment, alignof(JsonAllocator*)));
+}
+
+JsonAllocator& JsonAllocator::Current()
+{
+  return *CurrentSlot();
+}
+
+JsonAllocator& JsonAllocator::Default()
+{
+  static DefaultAllocator allocator;
+  return allocator;
+}
+
+JsonAllocator*& JsonAllocator::CurrentSlot()
+{
+  thread_local JsonAllocator* current = &Default();
+  return current;
+}
+
+JsonCountingAllocator::JsonCountingAllocator(JsonAllocator& upstream)
+  : upstream_{ upstream }
+{
+}
+
+void* JsonCountingAllocator::Allocate(size_t size, size_t alignment)
+{
+  void* ptr = upstream_.Allocate(size, alignment);
+
+  stats_.allocations++;
+  stats_.allocated_bytes += size;
+  stats_.live_bytes += size;
+  stats_.peak_bytes = std::max(stats_.peak_bytes, stats_.live_bytes);
+
+  return ptr;
+}
+
+void JsonCountingAllocator::Deallocate(void* ptr, size_t size, size_t alignment)
+{
+  upstream_.Deallocate(ptr, size, alignment);
+
+  // Memory allocated before counting started is not part of live_bytes
+  stats_.deallocations++;
+  stats_.live_bytes -= std::min(stats_.live_bytes, size);
+}
+
+const JsonAllocationStats& JsonCountingAllocator::GetStats() const
+{
+  return stats_;
+}
+
+void JsonCountingAllocator::ResetStats()
+{
+  stats_ = JsonAllocationStats();
+}
+
+JsonPoolAllocator::JsonPoolAllocator(size_t block_size, size_t max_blocks, JsonAllocator& upstream)
+  : block_size_{ block_size }
+  , max_blocks_{ max_blocks }
+  , upstream_{ &upstream }
+{
+}
+
+JsonPoolAllocator::~JsonPoolAllocator()
+{
+  Release();
+}
+
+void* JsonPoolAllocator::Allocate(size_t size, size_t alignment)
+{
+  if (IsPooled(size, alignment) && !free_blocks_.empty())
+  {
+    void* ptr = free_blocks_.back();
+    free_blocks_.pop_back();
+    return ptr;
+  }
+
+  return upstream_->Allocate(size, alignment);
+}
+
+void JsonPoolAllocator::Deallocate(void* ptr, size_t size, size_t alignment)
+{
+  if (IsPooled(size, alignment) && free_blocks_.size() < max_blocks_)
+  {
+    free_blocks_.push_back(ptr);
+    return;
+  }
+
+  upstream_->Deallocate(ptr, size, alignment);
+}
+
+JsonAllocator& JsonPoolAllocator::GetOwner()
+{
+  return upstream_->GetOwner();
+}
+
+void JsonPoolAllocator::SetUpstream(JsonAllocator& upstream)
+{
+  if (upstream_ != &upstream)
+  {
+    Release();
+  }
+  upstream_ = &upstream;
+}
+
+size_t JsonPoolAllocator::GetCachedBlocks() const
+{
+  return free_blocks_.size();
+}
+
+void JsonPoolAllocator::Release()
+{
+  for (void* ptr : free_blocks_)
+  {
+    upstream_->Deallocate(ptr, block_size_, alignof(std::max_align_t));
+  }
+
+  free_blocks_.clear();
+  free_blocks_.shrink_to_fit();
+}
+
+bool JsonPoolAllocator::IsPooled(size_t size, size_t alignment) const
+{
+  return size == block_size_ && alignment <= alignof(std::max_align_t);
+}
+
+JsonAllocatorScope::JsonAllocatorScope(JsonAllocator& allocator)
+  : previous_{ JsonAllocator::CurrentSlot() }
+{
+  JsonAllocator::CurrentSlot() = &allocator;
+}
+
+JsonAllocatorScope::~JsonAllocatorScope()
+{
+  JsonAllocator::CurrentSlot() = previous_;
+}
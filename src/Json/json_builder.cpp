@@ -0,0 +1,61 @@
+#include "json_builder.h"
+
+JsonBuilder::JsonBuilder(Json& target, Json::ValueType type, KeyCheck key_check)
+  : target_{ target }
+  , key_check_{ key_check }
+  , valid_{ false }
+{
+  if (type != Json::ValueType::Object && type != Json::ValueType::Array) return;
+
+  auto current_type = target_.GetType();
+  if (current_type == Json::ValueType::Null || current_type == Json::ValueType::Undefined)
+  {
+    target_.SetType(type);
+  }
+
+  if (target_.GetType() != type) return;
+
+  target_.Unpack();
+  valid_ = true;
+
+  if (key_check_ == KeyCheck::Hashed && type == Json::ValueType::Object)
+  {
+    keys_.reserve(target_.children_.size());
+    for (auto& child : target_.children_)
+    {
+      keys_.insert(child->key_.View());
+    }
+  }
+}
+
+bool JsonBuilder::IsValid() const
+{
+  return valid_;
+}
+
+Json& JsonBuilder::GetTarget() const
+{
+  return target_;
+}
+
+JsonBuilder& JsonBuilder::Reserve(size_t count)
+{
+  if (valid_)
+  {
+    Children().reserve(count);
+    if (key_check_ == KeyCheck::Hashed) keys_.reserve(count);
+  }
+
+  return *this;
+}
+
+bool JsonBuilder::AcceptKey(std::string_view key)
+{
+  if (key_check_ == KeyCheck::None) return true;
+  return !keys_.contains(key);
+}
+
+ChildrenList& JsonBuilder::Children() const
+{
+  return target_.children_;
+}
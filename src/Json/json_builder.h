@@ -0,0 +1,205 @@
+#ifndef JSON_BUILDER_H
+#define JSON_BUILDER_H
+
+#include <string_view>
+#include <unordered_set>
+#include <ranges>
+#include <memory>
+#include <utility>
+#include <type_traits>
+
+#include "json.h"
+
+/*
+ * Bulk construction of objects and arrays.
+ *
+ * Children are appended straight to the target's children list without the
+ * sibling scan done by SetKey. KeyCheck::Hashed rejects duplicate keys with a
+ * hash set instead, so building an N-key object stays O(N) either way.
+ * Existing nodes (std::unique_ptr<Json>) and JsonString keys/values are moved in.
+ */
+class JsonBuilder {
+public:
+  enum class KeyCheck {
+    None,
+    Hashed,
+  };
+
+  JsonBuilder(Json& target, Json::ValueType type, KeyCheck key_check = KeyCheck::None);
+
+  /* False when the target could not be turned into the requested type */
+  bool IsValid() const;
+  Json& GetTarget() const;
+
+  JsonBuilder& Reserve(size_t count);
+
+  /* Objects - return nullptr on duplicate key (KeyCheck::Hashed) or wrong target type */
+  template<typename T>
+  Json* Add(std::string_view key, T&& value);
+
+  template<typename T>
+  Json* Add(JsonString&& key, T&& value);
+
+  /* Arrays */
+  template<typename T>
+    requires (!std::ranges::range<T> || StringLike<T>)
+  Json* Append(T&& value);
+
+  /* Batch insert: array values, or std::pair<key, value> for objects */
+  template<std::ranges::input_range R>
+    requires (!StringLike<R>)
+  size_t Append(R&& range);
+
+private:
+  template<typename T>
+  Json* Insert(JsonString&& key, T&& value);
+
+  template<typename T>
+  static void AssignValue(Json& node, T&& value);
+
+  // Elements of a range passed as an rvalue are moved from
+  template<typename R, typename E>
+  static decltype(auto) ForwardElement(E& element);
+
+  bool AcceptKey(std::string_view key);
+  ChildrenList& Children() const;
+
+  Json& target_;
+  KeyCheck key_check_;
+  bool valid_;
+  std::unordered_set<std::string_view> keys_;
+};
+
+
+template<typename T>
+Json* JsonBuilder::Add(std::string_view key, T&& value)
+{
+  return Add(JsonString(key), std::forward<T>(value));
+}
+
+template<typename T>
+Json* JsonBuilder::Add(JsonString&& key, T&& value)
+{
+  if (!valid_ || target_.GetType() != Json::ValueType::Object) return nullptr;
+  if (!AcceptKey(key.View())) return nullptr;
+
+  return Insert(std::move(key), std::forward<T>(value));
+}
+
+template<typename T>
+  requires (!std::ranges::range<T> || StringLike<T>)
+Json* JsonBuilder::Append(T&& value)
+{
+  if (!valid_ || target_.GetType() != Json::ValueType::Array) return nullptr;
+
+  return Insert(JsonString(), std::forward<T>(value));
+}
+
+template<std::ranges::input_range R>
+  requires (!StringLike<R>)
+size_t JsonBuilder::Append(R&& range)
+{
+  if (!valid_) return 0;
+
+  if constexpr (std::ranges::sized_range<R>)
+  {
+    Reserve(Children().size() + std::ranges::size(range));
+  }
+
+  size_t added = 0;
+
+  for (auto&& element : range)
+  {
+    Json* node = nullptr;
+
+    if constexpr (requires { element.first; element.second; })
+    {
+      // Parenthesized, decltype of the plain member access would give its declared type
+      using Element = decltype((ForwardElement<R>(element)));
+      using Key = std::remove_reference_t<decltype((element.first))>;
+
+      if constexpr (std::is_rvalue_reference_v<Element> && std::is_same_v<Key, JsonString>)
+      {
+        node = Add(std::move(element.first), ForwardElement<R>(element).second);
+      }
+      else
+      {
+        node = Add(std::string_view(element.first), ForwardElement<R>(element).second);
+      }
+    }
+    else
+    {
+      node = Append(ForwardElement<R>(element));
+    }
+
+    if (node != nullptr) added++;
+  }
+
+  return added;
+}
+
+template<typename T>
+Json* JsonBuilder::Insert(JsonString&& key, T&& value)
+{
+  using Value = std::remove_cvref_t<T>;
+  auto& children = Children();
+
+  target_.InvalidateHash();
+
+  if constexpr (std::is_same_v<Value, std::unique_ptr<Json>>)
+  {
+    static_assert(std::is_rvalue_reference_v<T&&>, "JsonBuilder takes ownership of nodes, pass them with std::move");
+
+    if (value == nullptr) return nullptr;
+    children.push_back(std::move(value));
+  }
+  else
+  {
+    children.push_back(std::make_unique<Json>());
+    AssignValue(*children.back(), std::forward<T>(value));
+  }
+
+  auto& node = *children.back();
+  node.parent_ = &target_;
+  node.key_ = std::move(key);
+
+  if (key_check_ == KeyCheck::Hashed && target_.GetType() == Json::ValueType::Object)
+  {
+    keys_.insert(node.key_.View());
+  }
+
+  return &node;
+}
+
+template<typename R, typename E>
+decltype(auto) JsonBuilder::ForwardElement(E& element)
+{
+  if constexpr (std::is_lvalue_reference_v<R>) return (element);
+  else return std::move(element);
+}
+
+template<typename T>
+void JsonBuilder::AssignValue(Json& node, T&& value)
+{
+  using Value = std::remove_cvref_t<T>;
+
+  if constexpr (std::is_same_v<Value, Json>)
+  {
+    node = std::forward<T>(value);
+  }
+  else if constexpr (std::is_same_v<Value, JsonString> && std::is_rvalue_reference_v<T&&>)
+  {
+    node.SetType(Json::ValueType::String);
+    node.string_ = std::move(value);
+  }
+  else if constexpr (std::is_same_v<Value, std::nullptr_t>)
+  {
+    node.ClearValue();
+  }
+  else
+  {
+    node.SetValue(std::forward<T>(value));
+  }
+}
+
+#endif // !JSON_BUILDER_H
@@ -0,0 +1,372 @@
+#include <algorithm>
+#include <charconv>
+
+#include "json_columns.h"
+
+JsonColumn::JsonColumn(std::vector<std::string> path, Type type)
+  : path_{ std::move(path) }
+  , type_{ type }
+  , size_{ 0 }
+  , null_count_{ 0 }
+{
+  offsets_.push_back(0);
+}
+
+const std::vector<std::string>& JsonColumn::GetPath() const
+{
+  return path_;
+}
+
+JsonColumn::Type JsonColumn::GetType() const
+{
+  return type_;
+}
+
+size_t JsonColumn::Size() const
+{
+  return size_;
+}
+
+bool JsonColumn::IsNull(size_t row) const
+{
+  return (null_bitmap_[row / 64] >> (row % 64)) & 1;
+}
+
+size_t JsonColumn::GetNullCount() const
+{
+  return null_count_;
+}
+
+std::span<const uint64_t> JsonColumn::GetNullBitmap() const
+{
+  return null_bitmap_;
+}
+
+std::span<const double> JsonColumn::GetNumbers() const
+{
+  return numbers_;
+}
+
+std::span<const uint8_t> JsonColumn::GetBools() const
+{
+  return bools_;
+}
+
+std::span<const uint64_t> JsonColumn::GetOffsets() const
+{
+  return offsets_;
+}
+
+std::string_view JsonColumn::GetBytes() const
+{
+  return bytes_;
+}
+
+std::string_view JsonColumn::StringAt(size_t row) const
+{
+  if (type_ != Type::String) return {};
+  return std::string_view(bytes_).substr(offsets_[row], offsets_[row + 1] - offsets_[row]);
+}
+
+void JsonColumn::AppendNull()
+{
+  AppendRow(true);
+}
+
+void JsonColumn::AppendNumber(double value)
+{
+  if (type_ == Type::Auto) type_ = Type::Number;
+  if (type_ != Type::Number) return AppendNull();
+
+  AppendRow(false);
+  numbers_.back() = value;
+}
+
+void JsonColumn::AppendBool(bool value)
+{
+  if (type_ == Type::Auto) type_ = Type::Bool;
+  if (type_ != Type::Bool) return AppendNull();
+
+  AppendRow(false);
+  bools_.back() = value ? 1 : 0;
+}
+
+void JsonColumn::AppendString(std::string_view value)
+{
+  if (type_ == Type::Auto) type_ = Type::String;
+  if (type_ != Type::String) return AppendNull();
+
+  bytes_.append(value);
+  AppendRow(false);
+}
+
+void JsonColumn::AppendRow(bool null)
+{
+  if (size_ % 64 == 0) null_bitmap_.push_back(0);
+
+  if (null)
+  {
+    null_bitmap_.back() |= uint64_t(1) << (size_ % 64);
+    null_count_++;
+  }
+
+  // Null rows keep a placeholder, so value buffers stay indexable by row
+  switch (type_)
+  {
+  case Type::Number: numbers_.push_back(0); break;
+  case Type::Bool:   bools_.push_back(0); break;
+  case Type::String: offsets_.push_back(bytes_.size()); break;
+  default:           break;
+  }
+
+  size_++;
+
+  // Leading nulls of an Auto column get their placeholders once the type is known
+  if (type_ == Type::Number && numbers_.size() < size_) numbers_.insert(numbers_.begin(), size_ - numbers_.size(), 0);
+  if (type_ == Type::Bool && bools_.size() < size_) bools_.insert(bools_.begin(), size_ - bools_.size(), 0);
+  if (type_ == Type::String && offsets_.size() < size_ + 1) offsets_.insert(offsets_.begin(), size_ + 1 - offsets_.size(), 0);
+}
+
+void JsonColumn::Clear()
+{
+  size_ = 0;
+  null_count_ = 0;
+  null_bitmap_.clear();
+  numbers_.clear();
+  bools_.clear();
+  offsets_.assign(1, 0);
+  bytes_.clear();
+}
+
+JsonColumnExtractor::JsonColumnExtractor(std::vector<Field> fields)
+  : row_count_{ 0 }
+{
+  columns_.reserve(fields.size());
+
+  for (auto& field : fields)
+  {
+    PathNode* node = &root_;
+    for (const auto& key : field.path)
+    {
+      auto it = std::find_if(node->children.begin(), node->children.end(),
+        [&key](const PathNode& child) { return child.key == key; });
+
+      if (it == node->children.end())
+      {
+        node->children.push_back(PathNode{ key, {}, {} });
+        node = &node->children.back();
+      }
+      else
+      {
+        node = &*it;
+      }
+    }
+
+    node->columns.push_back(columns_.size());
+    columns_.emplace_back(std::move(field.path), field.type);
+  }
+}
+
+bool JsonColumnExtractor::Extract(const Json& array)
+{
+  if (array.GetType() != Json::ValueType::Array) return false;
+
+  array.ForEachChild([this](const Json& record) {
+    for (auto& column : columns_)
+    {
+      const Json* value = &record;
+      for (const auto& key : column.GetPath())
+      {
+        if (value->GetType() != Json::ValueType::Object) value = nullptr;
+        else value = (*value)[key];
+
+        if (value == nullptr) break;
+      }
+
+      AppendValue(column, value);
+    }
+    FinishRow();
+    });
+
+  return true;
+}
+
+bool JsonColumnExtractor::Extract(std::string_view data, const std::vector<std::string>& array_path)
+{
+  JsonStreamCursor cursor{ data };
+  return Extract(cursor, array_path);
+}
+
+bool JsonColumnExtractor::Extract(JsonChunkReader reader, const std::vector<std::string>& array_path)
+{
+  JsonStreamCursor cursor{ std::move(reader) };
+  return Extract(cursor, array_path);
+}
+
+size_t JsonColumnExtractor::GetRowCount() const
+{
+  return row_count_;
+}
+
+const JsonColumn& JsonColumnExtractor::GetColumn(size_t index) const
+{
+  return columns_[index];
+}
+
+std::span<const JsonColumn> JsonColumnExtractor::GetColumns() const
+{
+  return columns_;
+}
+
+void JsonColumnExtractor::Clear()
+{
+  for (auto& column : columns_) column.Clear();
+  row_count_ = 0;
+}
+
+bool JsonColumnExtractor::Extract(JsonStreamCursor& cursor, const std::vector<std::string>& array_path)
+{
+  // Same walk as JsonParser::StreamElements
+  std::string key;
+  for (const auto& component : array_path)
+  {
+    if (!cursor.Expect('{')) return false;
+
+    while (true)
+    {
+      if (!cursor.ReadString(key) || !cursor.Expect(':')) return false;
+      if (key == component) break;
+
+      if (!cursor.SkipValue() || !cursor.Expect(',')) return false;
+    }
+  }
+
+  if (!cursor.Expect('[')) return false;
+  if (cursor.Expect(']')) return true;
+
+  while (true)
+  {
+    bool valid = ReadValue(cursor, root_);
+    FinishRow();
+
+    if (!valid) return false;
+
+    if (cursor.Expect(',')) continue;
+    return cursor.Expect(']');
+  }
+}
+
+bool JsonColumnExtractor::ReadValue(JsonStreamCursor& cursor, const PathNode& node)
+{
+  if (!node.columns.empty())
+  {
+    value_buffer_.clear();
+    if (!cursor.CaptureValue(value_buffer_)) return false;
+
+    for (auto index : node.columns) AppendText(columns_[index], value_buffer_);
+    if (node.children.empty() || value_buffer_.front() != '{') return true;
+
+    // Also a prefix of other fields, read them from the captured object
+    std::string text = std::move(value_buffer_);
+    JsonStreamCursor nested{ text };
+    nested.Expect('{');
+    return ReadObject(nested, node);
+  }
+
+  if (node.children.empty()) return cursor.SkipValue();
+  if (!cursor.Expect('{')) return cursor.SkipValue();
+
+  return ReadObject(cursor, node);
+}
+
+bool JsonColumnExtractor::ReadObject(JsonStreamCursor& cursor, const PathNode& node)
+{
+  if (cursor.Expect('}')) return true;
+
+  std::string key;
+  while (true)
+  {
+    if (!cursor.ReadString(key) || !cursor.Expect(':')) return false;
+
+    auto it = std::find_if(node.children.begin(), node.children.end(),
+      [&key](const PathNode& child) { return child.key == key; });
+
+    bool valid = it == node.children.end() ? cursor.SkipValue() : ReadValue(cursor, *it);
+    if (!valid) return false;
+
+    if (cursor.Expect(',')) continue;
+    return cursor.Expect('}');
+  }
+}
+
+void JsonColumnExtractor::AppendText(JsonColumn& column, std::string_view text)
+{
+  // Duplicate keys, the first occurrence wins
+  if (column.Size() > row_count_) return;
+
+  switch (text.front())
+  {
+  case 'n':
+    column.AppendNull();
+    return;
+
+  case 't':
+  case 'f':
+    column.AppendBool(text.front() == 't');
+    return;
+
+  case '\"':
+  {
+    auto body = text.substr(1, text.size() - 2);
+    if (body.find('\\') == std::string_view::npos)
+    {
+      column.AppendString(body);
+      return;
+    }
+
+    // Escaped strings are rare, let the parser decode them
+    auto array = Json::Parse("[" + std::string(text) + "]");
+    AppendValue(column, (*static_cast<const Json*>(array.get()))[0]);
+    return;
+  }
+
+  case '{':
+  case '[':
+    column.AppendNull();
+    return;
+
+  default:
+  {
+    double value = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+
+    if (error != std::errc() || end != text.data() + text.size()) column.AppendNull();
+    else column.AppendNumber(value);
+    return;
+  }
+  }
+}
+
+void JsonColumnExtractor::AppendValue(JsonColumn& column, const Json* value)
+{
+  if (value == nullptr) return column.AppendNull();
+
+  switch (value->GetType())
+  {
+  case Json::ValueType::String: return column.AppendString(std::get<std::string_view>(value->GetValue()));
+  case Json::ValueType::Number: return column.AppendNumber(std::get<Number>(value->GetValue()));
+  case Json::ValueType::Bool:   return column.AppendBool(std::get<Bool>(value->GetValue()));
+  default:                      return column.AppendNull();
+  }
+}
+
+void JsonColumnExtractor::FinishRow()
+{
+  row_count_++;
+
+  // Fields absent from the record
+  for (auto& column : columns_)
+  {
+    while (column.Size() < row_count_) column.AppendNull();
+  }
+}
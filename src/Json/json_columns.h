@@ -0,0 +1,115 @@
+#ifndef JSON_COLUMNS_H
+#define JSON_COLUMNS_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <cstdint>
+
+#include "json.h"
+#include "json_stream.h"
+
+/*
+ * One extracted field of an array of records, stored contiguously.
+ * Numbers and bools are one value per row (0 for null rows), strings are
+ * rows + 1 offsets into one byte buffer. Bit i of the null bitmap is set
+ * when row i is missing, null or of a different type than the column.
+ */
+class JsonColumn {
+public:
+  enum class Type : int8_t {
+    Auto = -1,  // Taken from the first non-null value
+    Number,
+    Bool,
+    String,
+  };
+
+  JsonColumn(std::vector<std::string> path, Type type);
+
+  const std::vector<std::string>& GetPath() const;
+  Type GetType() const;
+  size_t Size() const;
+
+  bool IsNull(size_t row) const;
+  size_t GetNullCount() const;
+  std::span<const uint64_t> GetNullBitmap() const;
+
+  std::span<const double> GetNumbers() const;
+  std::span<const uint8_t> GetBools() const;
+  std::span<const uint64_t> GetOffsets() const;
+  std::string_view GetBytes() const;
+  std::string_view StringAt(size_t row) const;
+
+  void AppendNull();
+  void AppendNumber(double value);
+  void AppendBool(bool value);
+  void AppendString(std::string_view value);
+
+  void Clear();
+
+private:
+  void AppendRow(bool null);
+
+  std::vector<std::string> path_;
+  Type type_;
+  size_t size_;
+  size_t null_count_;
+
+  std::vector<uint64_t> null_bitmap_;
+  std::vector<double> numbers_;
+  std::vector<uint8_t> bools_;
+  std::vector<uint64_t> offsets_;
+  std::string bytes_;
+};
+
+/*
+ * Turns an array of objects into one JsonColumn per field path in a single pass.
+ * Text input is scanned with JsonStreamCursor and never builds Json nodes, only
+ * the values of requested fields are converted. Rows accumulate over calls
+ * until Clear(). Keys are matched as written, escape sequences are not decoded.
+ */
+class JsonColumnExtractor {
+public:
+  struct Field {
+    std::vector<std::string> path;
+    JsonColumn::Type type = JsonColumn::Type::Auto;
+  };
+
+  explicit JsonColumnExtractor(std::vector<Field> fields);
+
+  /* array_path leads to the records array like in JsonParser::ParseElements().
+     Return false on malformed input, the rows read so far are kept and the
+     record cut short by the error has its remaining fields null. */
+  bool Extract(const Json& array);
+  bool Extract(std::string_view data, const std::vector<std::string>& array_path = {});
+  bool Extract(JsonChunkReader reader, const std::vector<std::string>& array_path = {});
+
+  size_t GetRowCount() const;
+  const JsonColumn& GetColumn(size_t index) const;
+  std::span<const JsonColumn> GetColumns() const;
+
+  void Clear();
+
+private:
+  // Field paths merged into a trie, columns is empty for intermediate keys
+  struct PathNode {
+    std::string key;
+    std::vector<size_t> columns;
+    std::vector<PathNode> children;
+  };
+
+  bool Extract(JsonStreamCursor& cursor, const std::vector<std::string>& array_path);
+  bool ReadObject(JsonStreamCursor& cursor, const PathNode& node);
+  bool ReadValue(JsonStreamCursor& cursor, const PathNode& node);
+  void AppendText(JsonColumn& column, std::string_view text);
+  void AppendValue(JsonColumn& column, const Json* value);
+  void FinishRow();
+
+  std::vector<JsonColumn> columns_;
+  PathNode root_;
+  size_t row_count_;
+  std::string value_buffer_;
+};
+
+#endif // !JSON_COLUMNS_H
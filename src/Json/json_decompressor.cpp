@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#ifdef TOOLKIT_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef TOOLKIT_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+#include "json_decompressor.h"
+
+struct JsonDecompressor::State {
+#ifdef TOOLKIT_HAS_ZLIB
+  z_stream zlib{};
+  bool zlib_initialized = false;
+#endif
+
+#ifdef TOOLKIT_HAS_ZSTD
+  ZSTD_DStream* zstd = nullptr;
+#endif
+
+  ~State()
+  {
+#ifdef TOOLKIT_HAS_ZLIB
+    if (zlib_initialized) inflateEnd(&zlib);
+#endif
+
+#ifdef TOOLKIT_HAS_ZSTD
+    if (zstd != nullptr) ZSTD_freeDStream(zstd);
+#endif
+  }
+};
+
+JsonDecompressor::JsonDecompressor(JsonChunkReader compressed, Format format, size_t chunk_size)
+  : source_{ std::move(compressed) }
+  , format_{ format }
+  , failed_{ false }
+  , source_finished_{ false }
+  , frame_finished_{ false }
+  , input_capacity_{ chunk_size > 0 ? chunk_size : JsonStreamCursor::kDefaultChunkSize }
+  , input_pos_{ 0 }
+  , input_size_{ 0 }
+  , state_{ std::make_unique<State>() }
+{
+  input_ = std::make_unique<char[]>(input_capacity_);
+}
+
+JsonDecompressor::~JsonDecompressor() = default;
+
+bool JsonDecompressor::IsSupported(Format format)
+{
+  switch (format)
+  {
+#ifdef TOOLKIT_HAS_ZLIB
+  case Format::Gzip:  return true;
+#endif
+#ifdef TOOLKIT_HAS_ZSTD
+  case Format::Zstd:  return true;
+#endif
+  case Format::Auto:
+  case Format::Plain: return true;
+  default:            return false;
+  }
+}
+
+size_t JsonDecompressor::Read(char* buffer, size_t size)
+{
+  if (failed_ || size == 0) return 0;
+
+  if (format_ == Format::Auto) DetectFormat();
+
+  if (!IsSupported(format_))
+  {
+    failed_ = true;
+    return 0;
+  }
+
+  switch (format_)
+  {
+  case Format::Gzip:  return ReadGzip(buffer, size);
+  case Format::Zstd:  return ReadZstd(buffer, size);
+  default:            return ReadPlain(buffer, size);
+  }
+}
+
+JsonChunkReader JsonDecompressor::GetReader()
+{
+  return [this](char* buffer, size_t size) { return Read(buffer, size); };
+}
+
+JsonDecompressor::Format JsonDecompressor::GetFormat() const
+{
+  return format_;
+}
+
+bool JsonDecompressor::Failed() const
+{
+  return failed_;
+}
+
+bool JsonDecompressor::Refill()
+{
+  if (source_finished_) return false;
+
+  // Keep unread bytes, the format check may need more than one small chunk
+  if (input_pos_ > 0)
+  {
+    std::memmove(input_.get(), input_.get() + input_pos_, input_size_ - input_pos_);
+    input_size_ -= input_pos_;
+    input_pos_ = 0;
+  }
+
+  size_t count = source_(input_.get() + input_size_, input_capacity_ - input_size_);
+  if (count == 0)
+  {
+    source_finished_ = true;
+    return false;
+  }
+
+  input_size_ += count;
+  return true;
+}
+
+void JsonDecompressor::DetectFormat()
+{
+  while (input_size_ < 4 && Refill()) {}
+
+  auto byte = [this](size_t index) { return static_cast<unsigned char>(input_[index]); };
+
+  format_ = Format::Plain;
+
+  if (input_size_ >= 2 && byte(0) == 0x1F && byte(1) == 0x8B)
+  {
+    format_ = Format::Gzip;
+  }
+  else if (input_size_ >= 2 && (byte(0) & 0x0F) == 8 && (byte(0) * 256 + byte(1)) % 31 == 0)
+  {
+    format_ = Format::Gzip;
+  }
+  else if (input_size_ >= 4 && byte(0) == 0x28 && byte(1) == 0xB5 && byte(2) == 0x2F && byte(3) == 0xFD)
+  {
+    format_ = Format::Zstd;
+  }
+}
+
+size_t JsonDecompressor::ReadPlain(char* buffer, size_t size)
+{
+  if (input_pos_ == input_size_)
+  {
+    if (source_finished_) return 0;
+    return source_(buffer, size);
+  }
+
+  size_t count = std::min(size, input_size_ - input_pos_);
+  std::memcpy(buffer, input_.get() + input_pos_, count);
+  input_pos_ += count;
+  return count;
+}
+
+size_t JsonDecompressor::ReadGzip([[maybe_unused]] char* buffer, [[maybe_unused]] size_t size)
+{
+#ifdef TOOLKIT_HAS_ZLIB
+  auto& stream = state_->zlib;
+
+  if (!state_->zlib_initialized)
+  {
+    // 15 + 32: largest window, detect gzip or zlib header
+    if (inflateInit2(&stream, 15 + 32) != Z_OK)
+    {
+      failed_ = true;
+      return 0;
+    }
+    state_->zlib_initialized = true;
+  }
+
+  while (true)
+  {
+    bool has_input = input_pos_ < input_size_ || Refill();
+
+    // Concatenated members (e.g. appended log archives)
+    if (frame_finished_)
+    {
+      if (!has_input) return 0;
+
+      inflateReset(&stream);
+      frame_finished_ = false;
+    }
+
+    stream.next_in = reinterpret_cast<Bytef*>(input_.get() + input_pos_);
+    stream.avail_in = static_cast<uInt>(std::min<size_t>(input_size_ - input_pos_, UINT_MAX));
+    stream.next_out = reinterpret_cast<Bytef*>(buffer);
+    stream.avail_out = static_cast<uInt>(std::min<size_t>(size, UINT_MAX));
+
+    uInt available_in = stream.avail_in;
+    uInt available_out = stream.avail_out;
+
+    int result = inflate(&stream, Z_NO_FLUSH);
+
+    input_pos_ += available_in - stream.avail_in;
+    size_t produced = available_out - stream.avail_out;
+
+    if (result == Z_STREAM_END)
+    {
+      frame_finished_ = true;
+    }
+    else if (result != Z_OK && result != Z_BUF_ERROR)
+    {
+      failed_ = true;
+      return produced;
+    }
+
+    if (produced > 0) return produced;
+
+    // Input ended inside a member
+    if (!has_input && !frame_finished_)
+    {
+      failed_ = true;
+      return 0;
+    }
+  }
+#else
+  failed_ = true;
+  return 0;
+#endif
+}
+
+size_t JsonDecompressor::ReadZstd([[maybe_unused]] char* buffer, [[maybe_unused]] size_t size)
+{
+#ifdef TOOLKIT_HAS_ZSTD
+  if (state_->zstd == nullptr)
+  {
+    state_->zstd = ZSTD_createDStream();
+    if (state_->zstd == nullptr || ZSTD_isError(ZSTD_initDStream(state_->zstd)))
+    {
+      failed_ = true;
+      return 0;
+    }
+  }
+
+  while (true)
+  {
+    bool has_input = input_pos_ < input_size_ || Refill();
+    if (frame_finished_ && !has_input) return 0;
+
+    ZSTD_inBuffer input{ input_.get(), input_size_, input_pos_ };
+    ZSTD_outBuffer output{ buffer, size, 0 };
+
+    size_t result = ZSTD_decompressStream(state_->zstd, &output, &input);
+    input_pos_ = input.pos;
+
+    if (ZSTD_isError(result))
+    {
+      failed_ = true;
+      return output.pos;
+    }
+
+    // 0 means a frame was completed and flushed, the next one may follow
+    frame_finished_ = result == 0;
+    if (output.pos > 0) return output.pos;
+
+    if (!has_input)
+    {
+      if (!frame_finished_) failed_ = true;
+      return 0;
+    }
+  }
+#else
+  failed_ = true;
+  return 0;
+#endif
+}
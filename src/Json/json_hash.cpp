@@ -0,0 +1,114 @@
+#include <cstring>
+
+#include "json_hash.h"
+
+namespace {
+  constexpr uint64_t kSecret0 = 0xa0761d6478bd642full;
+  constexpr uint64_t kSecret1 = 0xe7037ed1a0b428dbull;
+  constexpr uint64_t kSecret2 = 0x8ebc6af09c88c6e3ull;
+  constexpr uint64_t kSecret3 = 0x589965cc75374cc3ull;
+
+  /* 64x64 -> 128 bit multiply, returns the low half and stores the high half */
+  uint64_t Multiply(uint64_t a, uint64_t b, uint64_t& high)
+  {
+#if defined(__SIZEOF_INT128__)
+    auto product = static_cast<unsigned __int128>(a) * b;
+    high = static_cast<uint64_t>(product >> 64);
+    return static_cast<uint64_t>(product);
+#else
+    uint64_t lo_lo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    uint64_t hi_lo = (a >> 32) * (b & 0xFFFFFFFF);
+    uint64_t lo_hi = (a & 0xFFFFFFFF) * (b >> 32);
+    uint64_t hi_hi = (a >> 32) * (b >> 32);
+
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    high = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    return (cross << 32) | (lo_lo & 0xFFFFFFFF);
+#endif
+  }
+
+  uint64_t Fold(uint64_t a, uint64_t b)
+  {
+    uint64_t high = 0;
+    uint64_t low = Multiply(a, b, high);
+    return low ^ high;
+  }
+
+  uint64_t Read64(const unsigned char* data)
+  {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+
+  uint64_t Read32(const unsigned char* data)
+  {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+}
+
+uint64_t JsonHashBytes(const void* data, size_t size, uint64_t seed)
+{
+  auto bytes = static_cast<const unsigned char*>(data);
+  seed ^= Fold(seed ^ kSecret0, kSecret1);
+
+  uint64_t a = 0;
+  uint64_t b = 0;
+
+  if (size <= 16)
+  {
+    if (size >= 4)
+    {
+      size_t middle = (size >> 3) << 2;
+      a = (Read32(bytes) << 32) | Read32(bytes + middle);
+      b = (Read32(bytes + size - 4) << 32) | Read32(bytes + size - 4 - middle);
+    }
+    else if (size > 0)
+    {
+      a = (uint64_t(bytes[0]) << 16) | (uint64_t(bytes[size >> 1]) << 8) | bytes[size - 1];
+    }
+  }
+  else
+  {
+    size_t remaining = size;
+
+    if (remaining > 48)
+    {
+      uint64_t seed1 = seed;
+      uint64_t seed2 = seed;
+
+      do
+      {
+        seed = Fold(Read64(bytes) ^ kSecret1, Read64(bytes + 8) ^ seed);
+        seed1 = Fold(Read64(bytes + 16) ^ kSecret2, Read64(bytes + 24) ^ seed1);
+        seed2 = Fold(Read64(bytes + 32) ^ kSecret3, Read64(bytes + 40) ^ seed2);
+        bytes += 48;
+        remaining -= 48;
+      } while (remaining > 48);
+
+      seed ^= seed1 ^ seed2;
+    }
+
+    while (remaining > 16)
+    {
+      seed = Fold(Read64(bytes) ^ kSecret1, Read64(bytes + 8) ^ seed);
+      bytes += 16;
+      remaining -= 16;
+    }
+
+    // Last 16 bytes, overlapping already hashed ones when the tail is short
+    a = Read64(bytes + remaining - 16);
+    b = Read64(bytes + remaining - 8);
+  }
+
+  uint64_t high = 0;
+  uint64_t low = Multiply(a ^ kSecret1, b ^ seed, high);
+  return Fold(low ^ kSecret0 ^ size, high ^ kSecret1);
+}
+
+uint64_t JsonHashMix(uint64_t first, uint64_t second)
+{
+  return Fold(first ^ kSecret0, second ^ kSecret1) ^ first;
+}
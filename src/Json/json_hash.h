@@ -0,0 +1,16 @@
+#ifndef JSON_HASH_H
+#define JSON_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * 64-bit non-cryptographic hashing (wyhash-style multiply-fold) used for
+ * subtree hashes. Stable across runs and platforms of the same endianness.
+ */
+uint64_t JsonHashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+/* Order dependent combination of two hashes */
+uint64_t JsonHashMix(uint64_t first, uint64_t second);
+
+#endif // !JSON_HASH_H
@@ -0,0 +1,165 @@
+#include "json_packed_array.h"
+
+JsonPackedArray::JsonPackedArray(ElementType type)
+  : element_type_{ type }
+{
+}
+
+void* JsonPackedArray::operator new(size_t size)
+{
+  return JsonAllocator::AllocateOwned(size, alignof(JsonPackedArray));
+}
+
+void JsonPackedArray::operator delete(void* ptr, size_t size)
+{
+  JsonAllocator::DeallocateOwned(ptr, size, alignof(JsonPackedArray));
+}
+
+JsonPackedArray::ElementType JsonPackedArray::GetElementType() const
+{
+  return element_type_;
+}
+
+size_t JsonPackedArray::Size() const
+{
+  switch (element_type_)
+  {
+  case ElementType::Number:   return numbers_.size();
+  case ElementType::Integer:  return integers_.size();
+  default:                    return bools_.size();
+  }
+}
+
+bool JsonPackedArray::Empty() const
+{
+  return Size() == 0;
+}
+
+bool JsonPackedArray::IsNumeric() const
+{
+  return element_type_ != ElementType::Bool;
+}
+
+void JsonPackedArray::Reserve(size_t size)
+{
+  switch (element_type_)
+  {
+  case ElementType::Number:
+    numbers_.reserve(size);
+    break;
+  case ElementType::Integer:
+    integers_.reserve(size);
+    break;
+  default:
+    bools_.reserve(size);
+    break;
+  }
+}
+
+void JsonPackedArray::ShrinkToFit()
+{
+  numbers_.shrink_to_fit();
+  integers_.shrink_to_fit();
+  bools_.shrink_to_fit();
+}
+
+bool JsonPackedArray::AppendNumber(double value)
+{
+  if (element_type_ == ElementType::Bool) return false;
+  if (element_type_ == ElementType::Integer) PromoteToNumbers();
+
+  numbers_.push_back(value);
+  return true;
+}
+
+bool JsonPackedArray::AppendInteger(int64_t value)
+{
+  if (element_type_ == ElementType::Bool) return false;
+
+  if (element_type_ == ElementType::Number)
+  {
+    numbers_.push_back(static_cast<double>(value));
+  }
+  else
+  {
+    integers_.push_back(value);
+  }
+  return true;
+}
+
+bool JsonPackedArray::AppendBool(bool value)
+{
+  if (element_type_ != ElementType::Bool) return false;
+
+  bools_.push_back(value ? 1 : 0);
+  return true;
+}
+
+size_t JsonPackedArray::Compact(std::span<const uint8_t> remove_mask)
+{
+  auto compact = [&remove_mask](auto& buffer) {
+    size_t kept = 0;
+    for (size_t i = 0; i < buffer.size(); i++)
+    {
+      if (i < remove_mask.size() && remove_mask[i]) continue;
+      buffer[kept++] = buffer[i];
+    }
+
+    size_t removed = buffer.size() - kept;
+    buffer.resize(kept);
+    return removed;
+  };
+
+  switch (element_type_)
+  {
+  case ElementType::Number:   return compact(numbers_);
+  case ElementType::Integer:  return compact(integers_);
+  default:                    return compact(bools_);
+  }
+}
+
+double JsonPackedArray::NumberAt(size_t index) const
+{
+  if (element_type_ == ElementType::Integer) return static_cast<double>(integers_[index]);
+  return numbers_[index];
+}
+
+bool JsonPackedArray::BoolAt(size_t index) const
+{
+  return bools_[index] != 0;
+}
+
+std::span<const double> JsonPackedArray::GetNumbers() const
+{
+  return numbers_;
+}
+
+std::span<const int64_t> JsonPackedArray::GetIntegers() const
+{
+  return integers_;
+}
+
+std::span<const uint8_t> JsonPackedArray::GetBools() const
+{
+  return bools_;
+}
+
+size_t JsonPackedArray::HeapBytes() const
+{
+  return sizeof(JsonPackedArray)
+    + numbers_.capacity() * sizeof(double)
+    + integers_.capacity() * sizeof(int64_t)
+    + bools_.capacity() * sizeof(uint8_t);
+}
+
+void JsonPackedArray::PromoteToNumbers()
+{
+  numbers_.reserve(integers_.capacity());
+  for (auto value : integers_)
+  {
+    numbers_.push_back(static_cast<double>(value));
+  }
+
+  integers_ = decltype(integers_)();
+  element_type_ = ElementType::Number;
+}
@@ -1,21 +1,307 @@
 #include <variant>
+#include <charconv>
+#include <algorithm>
+#include <bit>
+#include <memory>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "json_parser.h"
 
+namespace {
+  constexpr size_t kMaxPooledNodes = 64 * 1024;
+  constexpr size_t kNodeBlockSize = JsonAllocator::GetOwnedSize(sizeof(Json), alignof(Json));
+
+  /* Counts the allocations of one parse, the tree stays owned by the upstream allocator */
+  class ParseCountingAllocator : public JsonCountingAllocator {
+  public:
+    explicit ParseCountingAllocator(JsonAllocator& upstream)
+      : JsonCountingAllocator{ upstream }
+      , upstream_{ upstream }
+    {
+    }
+
+    JsonAllocator& GetOwner() override
+    {
+      return upstream_.GetOwner();
+    }
+
+  private:
+    JsonAllocator& upstream_;
+  };
+
+  /* Length of the well-formed UTF-8 sequence at first, 0 when it is invalid */
+  size_t Utf8SequenceLength(const char* first, const char* last)
+  {
+    auto byte = [first](size_t index) { return static_cast<unsigned char>(first[index]); };
+
+    unsigned char lead = byte(0);
+    unsigned char second_min = 0x80;
+    unsigned char second_max = 0xBF;
+    size_t length = 0;
+
+    if (lead >= 0xC2 && lead <= 0xDF)
+    {
+      length = 2;
+    }
+    else if (lead >= 0xE0 && lead <= 0xEF)
+    {
+      length = 3;
+      if (lead == 0xE0) second_min = 0xA0;  // overlong
+      if (lead == 0xED) second_max = 0x9F;  // surrogates
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4)
+    {
+      length = 4;
+      if (lead == 0xF0) second_min = 0x90;  // overlong
+      if (lead == 0xF4) second_max = 0x8F;  // above U+10FFFF
+    }
+    else
+    {
+      return 0;
+    }
+
+    if (static_cast<size_t>(last - first) < length) return 0;
+    if (byte(1) < second_min || byte(1) > second_max) return 0;
+
+    for (size_t i = 2; i < length; i++)
+    {
+      if ((byte(i) & 0xC0) != 0x80) return 0;
+    }
+
+    return length;
+  }
+
+  /*
+   * Skips plain string content: ASCII other than '"', '\\' and control characters,
+   * and well-formed UTF-8 sequences. Returns the first byte that needs attention.
+   * SSE2 checks 16 bytes at a time, a signed compare against 0x20 flags both
+   * control characters and non-ASCII bytes.
+   */
+  const char* SkipPlainCharacters(const char* first, const char* last)
+  {
+    while (first != last)
+    {
+#if defined(__SSE2__)
+      const __m128i quote = _mm_set1_epi8('\"');
+      const __m128i backslash = _mm_set1_epi8('\\');
+      const __m128i space = _mm_set1_epi8(0x20);
+
+      while (last - first >= 16)
+      {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        __m128i special = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+          _mm_cmplt_epi8(chunk, space));
+
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+        if (mask != 0)
+        {
+          first += std::countr_zero(mask);
+          break;
+        }
+        first += 16;
+      }
+
+      if (first == last) break;
+#endif
+      auto byte = static_cast<unsigned char>(*first);
+
+      if (byte == '\"' || byte == '\\' || byte < 0x20) return first;
+
+      if (byte < 0x80)
+      {
+        first++;
+        continue;
+      }
+
+      size_t length = Utf8SequenceLength(first, last);
+      if (length == 0) return first;
+      first += length;
+    }
+
+    return last;
+  }
+
+  bool ReadHex4(std::string::const_iterator ch, uint32_t& value)
+  {
+    value = 0;
+    for (int i = 0; i < 4; i++, ch++)
+    {
+      char c = *ch;
+      value <<= 4;
+
+      if (c >= '0' && c <= '9') value |= c - '0';
+      else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+      else return false;
+    }
+    return true;
+  }
+
+  void AppendUtf8(std::string& str, uint32_t code_point)
+  {
+    if (code_point < 0x80)
+    {
+      str.push_back(static_cast<char>(code_point));
+    }
+    else if (code_point < 0x800)
+    {
+      str.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+      str.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+    else if (code_point < 0x10000)
+    {
+      str.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+      str.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+      str.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+    else
+    {
+      str.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+      str.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+      str.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+      str.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+  }
+}
 
 JsonParser::JsonParser()
   : parsing_state_{ ParsingState::Undefined }
   , stop_flag_{ false }
+  , allocator_{ nullptr }
+  , node_pool_{ kNodeBlockSize, kMaxPooledNodes }
+{
+}
+
+JsonParser::JsonParser(JsonAllocator& allocator)
+  : stop_flag_{ false }
+  , parsing_state_{ ParsingState::Undefined }
+  , allocator_{ &allocator }
+  , node_pool_{ kNodeBlockSize, kMaxPooledNodes, allocator }
+{
+}
+
+JsonElementGenerator JsonParser::ParseElements(std::string_view data, std::vector<std::string> path)
+{
+  return StreamElements(std::make_unique<JsonStreamCursor>(data), std::move(path));
+}
+
+JsonElementGenerator JsonParser::ParseElements(std::istream& input, std::vector<std::string> path)
+{
+  auto reader = [&input](char* buffer, size_t size) {
+    input.read(buffer, static_cast<std::streamsize>(size));
+    return static_cast<size_t>(input.gcount());
+  };
+  return ParseElements(JsonChunkReader(reader), std::move(path));
+}
+
+JsonElementGenerator JsonParser::ParseElements(JsonChunkReader reader, std::vector<std::string> path)
+{
+  return StreamElements(std::make_unique<JsonStreamCursor>(std::move(reader)), std::move(path));
+}
+
+JsonElementGenerator JsonParser::StreamElements(std::unique_ptr<JsonStreamCursor> cursor, std::vector<std::string> path)
+{
+  auto invalid = [] {
+    auto json = std::make_unique<Json>();
+    json->SetType(Json::ValueType::Undefined);
+    return json;
+  };
+
+  // Walk down the object keys, skipping the values of all other keys
+  std::string key;
+  for (const auto& component : path)
+  {
+    if (!cursor->Expect('{')) co_return;
+
+    while (true)
+    {
+      if (!cursor->ReadString(key) || !cursor->Expect(':')) co_return;
+      if (key == component) break;
+
+      if (!cursor->SkipValue() || !cursor->Expect(',')) co_return;
+    }
+  }
+
+  if (!cursor->Expect('[') || cursor->Expect(']')) co_return;
+
+  while (true)
+  {
+    element_buffer_.clear();
+    if (!cursor->CaptureValue(element_buffer_))
+    {
+      co_yield invalid();
+      co_return;
+    }
+
+    auto element = ParseElement(element_buffer_);
+    bool valid = element->GetType() != Json::ValueType::Undefined;
+
+    co_yield std::move(element);
+    if (!valid) co_return;
+
+    if (cursor->Expect(',')) continue;
+    if (cursor->Expect(']')) co_return;
+
+    co_yield invalid();
+    co_return;
+  }
+}
+
+std::unique_ptr<Json> JsonParser::ParseElement(const std::string& text)
 {
+  if (text.front() == '{' || text.front() == '[') return Parse(text);
+
+  // Parse() only accepts containers at the root, wrap scalars in an array
+  std::string wrapped = "[" + text + "]";
+  auto array = Parse(wrapped);
+  array->Unpack();
+
+  if (array->GetType() != Json::ValueType::Array || array->children_.size() != 1)
+  {
+    array->SetType(Json::ValueType::Undefined);
+    return array;
+  }
+
+  auto element = std::move(array->children_.front());
+  element->parent_ = nullptr;
+  return element;
+}
+
+void JsonParser::Recycle(std::unique_ptr<Json> json)
+{
+  JsonAllocatorScope allocator_scope{ node_pool_ };
+  json.reset();
+}
+
+void JsonParser::Reset()
+{
+  stop_flag_ = false;
+  parsing_state_ = ParsingState::Undefined;
+  allocation_stats_ = JsonAllocationStats();
+
+  string_buffer_ = std::string();
+  number_buffer_ = std::string();
+  node_pool_.Release();
+}
+
+const JsonAllocationStats& JsonParser::GetAllocationStats() const
+{
+  return allocation_stats_;
 }
 
 Json* JsonParser::AddNewPair(Json* current)
 {
-  if (!std::holds_alternative<ChildrenList>(current->value_))
+  current->Unpack();
+
+  if (!current->IsContainer())
   {
-    current->value_ = ChildrenList();
+    current->SetType(Json::ValueType::Object);
   }
-  auto& list = std::get<ChildrenList>(current->value_);
+  auto& list = current->children_;
   list.push_back(std::make_unique<Json>("", current));
   return list.back().get();
 }
@@ -25,11 +311,15 @@ void JsonParser::SetParsedValue(const std::string& value, Json* current)
   switch (current->value_type_)
   {
   case Json::ValueType::String:
-    current->value_ = value;
+    current->string_.Assign(value);
     break;
   case Json::ValueType::Number:
-    current->value_ = std::stod(value);
+  {
+    int64_t integer = 0;
+    current->number_ = std::stod(value);
+    current->is_integer_ = ReadInteger(value, integer);
     break;
+  }
   default:
     break;
   }
@@ -38,6 +328,17 @@ void JsonParser::SetParsedValue(const std::string& value, Json* current)
 
 std::unique_ptr<Json> JsonParser::Parse(const std::string& data, const ProgresCallback& progress_callback)
 {
+  if (allocator_ == nullptr)
+  {
+    node_pool_.SetUpstream(JsonAllocator::Current());
+  }
+
+  ParseCountingAllocator counting_allocator{ node_pool_ };
+  JsonAllocatorScope allocator_scope{ counting_allocator };
+
+  // The previous call leaves the flag set when its progress manager stops
+  stop_flag_ = false;
+
   auto root_ = std::make_unique<Json>("", nullptr);
   root_->SetType(Json::ValueType::Undefined);
   auto current = root_.get();
@@ -70,7 +371,7 @@ std::unique_ptr<Json> JsonParser::Parse(const std::string& data, const ProgresCa
 
     case '[':
       current->SetType(Json::ValueType::Array);
-      current->value_ = ChildrenList();
+      current->children_.clear();
       parsing_state_ = ParsingState::Array;
       break;
 
@@ -86,7 +387,10 @@ std::unique_ptr<Json> JsonParser::Parse(const std::string& data, const ProgresCa
       if ((it + 1) != end)
       {
         std::invoke(GetParsingMethod(parsing_state_), this, ++it, end, current);
-        parsing_state_ = current->IsRoot() ? ParsingState::Finished : parsing_state_.load();
+        if (parsing_state_ != ParsingState::Undefined)
+        {
+          parsing_state_ = current->IsRoot() ? ParsingState::Finished : parsing_state_.load();
+        }
       }
       else
       {
@@ -102,6 +406,13 @@ std::unique_ptr<Json> JsonParser::Parse(const std::string& data, const ProgresCa
     }
   }
 
+  allocation_stats_ = counting_allocator.GetStats();
+
+  // Do not keep a scope allocator of the caller past this call
+  if (allocator_ == nullptr)
+  {
+    node_pool_.SetUpstream(JsonAllocator::Default());
+  }
   return root_;
 }
 
@@ -109,31 +420,39 @@ std::unique_ptr<Json> JsonParser::Parse(const std::string& data, const ProgresCa
 
 void JsonParser::ParseString(char_iterator& ch, char_iterator& end, Json* current)
 {
-  std::string value = "";
+  auto& value = string_buffer_;
+  value.clear();
+
+  bool is_key = parsing_state_ == ParsingState::Key;
   ++ch;
 
   while (ch != end && !stop_flag_)
   {
+    // Validate and copy plain characters up to the next quote, escape or bad byte
+    auto first = std::to_address(ch);
+    auto plain_end = SkipPlainCharacters(first, std::to_address(end));
+    value.append(first, plain_end);
+    ch += plain_end - first;
+
+    if (ch == end) break;
+
     switch (*ch)
     {
-    case '\n':
-    case '\f':
-    case '\r':
-    case '\t':
-    case '\v':
-      parsing_state_ = ParsingState::Undefined;
-      return;
-
     case '\\':
-      parsing_state_ = ParsingState::EscapeChar;
-      ParseEscapeChar(ch, end, value);
+      if (!ParseEscapeChar(ch, end, value))
+      {
+        parsing_state_ = ParsingState::Undefined;
+        return;
+      }
       break;
 
     case '\"':
       if (current->GetType() == Json::ValueType::Object)
       {
-        if (parsing_state_ == ParsingState::Key) {
-          current->SetKey(value);
+        // Keys are stored without the sibling scan done by SetKey,
+        // duplicate keys are kept in document order
+        if (is_key) {
+          current->key_.Assign(value);
         }
         parsing_state_ = ParsingState::Object;
         return;
@@ -147,18 +466,33 @@ void JsonParser::ParseString(char_iterator& ch, char_iterator& end, Json* curren
 
       else if (current->GetType() == Json::ValueType::Array) parsing_state_ = ParsingState::Array;
       return;
-    default:
-      value.append(1, *ch);
 
-      break;
+    default:
+      // Control character or invalid UTF-8
+      parsing_state_ = ParsingState::Undefined;
+      return;
     }
     ch++;
   }
+
+  // The input ended inside the string
+  if (ch == end) parsing_state_ = ParsingState::Undefined;
 }
 
 void JsonParser::ParseNumber(char_iterator& ch, char_iterator& end, Json* current)
 {
-  std::string value = "";
+  auto& value = number_buffer_;
+  value.clear();
+
+  if (ReadNumber(ch, end, value))
+  {
+    SetParsedValue(value, current);
+    parsing_state_ = ParsingState::Object;
+  }
+}
+
+bool JsonParser::ReadNumber(char_iterator& ch, char_iterator& end, std::string& value)
+{
   bool decimal_point = false;
   value.append(1, *ch);
   ++ch;
@@ -178,20 +512,18 @@ void JsonParser::ParseNumber(char_iterator& ch, char_iterator& end, Json* curren
     case ']':
       if (value.back() >= '0' || value.back() <= '9')
       {
-        SetParsedValue(value, current);
         ch--;
-        parsing_state_ = ParsingState::Object;
+        return true;
       }
-      else
-      {
-        parsing_state_ = ParsingState::Undefined;
-      }
-      return;
+
+      parsing_state_ = ParsingState::Undefined;
+      return false;
 
     case '.':
       if (value.size() == 1 && value[0] == '-' || decimal_point == true)
       {
         parsing_state_ = ParsingState::Undefined;
+        return false;
       }
       else
       {
@@ -209,15 +541,15 @@ void JsonParser::ParseNumber(char_iterator& ch, char_iterator& end, Json* curren
       else
       {
         parsing_state_ = ParsingState::Undefined;
-        return;
+        return false;
       }
       break;
 
     case '-':
-      if (value.back() >= 'E' || value.back() <= 'e')
+      if (value.back() != 'E' && value.back() != 'e')
       {
         parsing_state_ = ParsingState::Undefined;
-        return;
+        return false;
       }
       else
       {
@@ -235,11 +567,24 @@ void JsonParser::ParseNumber(char_iterator& ch, char_iterator& end, Json* curren
     }
     ch++;
   }
+
+  // A number is always followed by a delimiter inside its container
+  if (ch == end) parsing_state_ = ParsingState::Undefined;
+  return false;
 }
 
-void JsonParser::ParseEscapeChar(char_iterator& ch, char_iterator& end, std::string& str)
+/* Integral text in int64 range. "-0" is not, as an integer it would lose its sign. */
+bool JsonParser::ReadInteger(const std::string& value, int64_t& integer)
 {
-  ++ch;
+  auto last = value.data() + value.size();
+  auto [ptr, error] = std::from_chars(value.data(), last, integer);
+  return error == std::errc() && ptr == last && !(integer == 0 && value.front() == '-');
+}
+
+
+bool JsonParser::ParseEscapeChar(char_iterator& ch, char_iterator& end, std::string& str)
+{
+  if (++ch == end) return false;
 
   switch (*ch)
   {
@@ -274,6 +619,10 @@ void JsonParser::ParseEscapeChar(char_iterator& ch, char_iterator& end, std::str
     str.append(1, '\"');
     break;
 
+  case '/':
+    str.append(1, '/');
+    break;
+
   case '\'':
     str.append(1, '\'');
     break;
@@ -286,11 +635,37 @@ void JsonParser::ParseEscapeChar(char_iterator& ch, char_iterator& end, std::str
     str.append(1, '\a');
     break;
 
+  case 'u':
+    return ParseUnicodeEscape(ch, end, str);
+
   default:
-    parsing_state_ = ParsingState::Undefined;
-    break;
+    return false;
   }
-  parsing_state_ = ParsingState::String;
+  return true;
+}
+
+/* ch points at 'u', on success it is left at the last hex digit consumed */
+bool JsonParser::ParseUnicodeEscape(char_iterator& ch, char_iterator& end, std::string& str)
+{
+  uint32_t code_point = 0;
+  if (end - ch <= 4 || !ReadHex4(ch + 1, code_point)) return false;
+  ch += 4;
+
+  if (code_point >= 0xDC00 && code_point <= 0xDFFF) return false;
+
+  if (code_point >= 0xD800 && code_point <= 0xDBFF)
+  {
+    // High surrogate, the low half must follow as another \u escape
+    uint32_t low = 0;
+    if (end - ch <= 6 || ch[1] != '\\' || ch[2] != 'u' || !ReadHex4(ch + 3, low)) return false;
+    if (low < 0xDC00 || low > 0xDFFF) return false;
+
+    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+    ch += 6;
+  }
+
+  AppendUtf8(str, code_point);
+  return true;
 }
 
 void JsonParser::ParseArray(char_iterator& ch, char_iterator& end, Json* current)
@@ -308,7 +683,11 @@ void JsonParser::ParseArray(char_iterator& ch, char_iterator& end, Json* current
       break;
     case ']':
     {
-      auto& list = std::get<ChildrenList>(current->value_);
+      // The enclosing object expects its next key
+      parsing_state_ = ParsingState::Object;
+      if (current->IsPacked()) return;
+
+      auto& list = current->children_;
       if (list.size() == 1 &&
         (*list.back()).GetType() == Json::ValueType::Undefined)
       {
@@ -336,10 +715,17 @@ void JsonParser::ParseArray(char_iterator& ch, char_iterator& end, Json* current
     case '9':
     case '0':
     case '-':
+      if (ParsePackedElement(ch, end, current))
+      {
+        if (parsing_state_ == ParsingState::Undefined) return;
+        break;
+      }
+
       current = AddNewPair(current);
       parsing_state_ = ParsingState::Value;
       std::invoke(GetParsingMethod(parsing_state_), this, ch, end, current);
       current = current->parent_;
+      if (parsing_state_ == ParsingState::Undefined) return;
       break;
 
     case '{':
@@ -348,6 +734,7 @@ void JsonParser::ParseArray(char_iterator& ch, char_iterator& end, Json* current
       current->SetType(Json::ValueType::Object);
       std::invoke(GetParsingMethod(parsing_state_), this, ch, end, current);
       current = current->parent_;
+      if (parsing_state_ == ParsingState::Undefined) return;
       break;
 
     default:
@@ -357,6 +744,8 @@ void JsonParser::ParseArray(char_iterator& ch, char_iterator& end, Json* current
     ch++;
   }
 
+  // The input ended before the closing bracket
+  if (ch == end) parsing_state_ = ParsingState::Undefined;
 }
 
 void JsonParser::ParseObject(char_iterator& ch, char_iterator& end, Json* current)
@@ -364,7 +753,6 @@ void JsonParser::ParseObject(char_iterator& ch, char_iterator& end, Json* curren
   current = AddNewPair(current);
 
   current->SetType(Json::ValueType::Object);
-  std::string name = "";
   bool is_key_set = false;
 
   while (ch != end && !stop_flag_)
@@ -384,6 +772,7 @@ void JsonParser::ParseObject(char_iterator& ch, char_iterator& end, Json* curren
       {
         parsing_state_ = ParsingState::Key;
         std::invoke(GetParsingMethod(parsing_state_), this, ch, end, current);
+        if (parsing_state_ == ParsingState::Undefined) return;
         is_key_set = true;
       }
       else {
@@ -395,8 +784,8 @@ void JsonParser::ParseObject(char_iterator& ch, char_iterator& end, Json* curren
     case '}':
     {
       current = current->parent_;
-      auto& list = std::get<ChildrenList>(current->value_);
-      if (list.size() > 0 && list[0]->key_ == "")
+      auto& list = current->children_;
+      if (list.size() > 0 && list[0]->key_.Empty())
       {
         list.pop_back();
       }
@@ -408,10 +797,12 @@ void JsonParser::ParseObject(char_iterator& ch, char_iterator& end, Json* curren
       {
         parsing_state_ = ParsingState::Value;
         std::invoke(GetParsingMethod(parsing_state_), this, ++ch, end, current);
+        if (parsing_state_ == ParsingState::Undefined) return;
       }
       else
       {
         parsing_state_ = ParsingState::Undefined;
+        return;
       }
       break;
 
@@ -422,19 +813,18 @@ void JsonParser::ParseObject(char_iterator& ch, char_iterator& end, Json* curren
       break;
 
     default:
-      name.append(1, *ch);
       break;
     }
 
     ch++;
   }
 
+  // The input ended before the closing brace
+  if (ch == end) parsing_state_ = ParsingState::Undefined;
 }
 
 void JsonParser::ParseValue(char_iterator& ch, char_iterator& end, Json* current)
 {
-  std::string value = "";
-
   while (ch != end && !stop_flag_)
   {
     switch (*ch)
@@ -458,7 +848,7 @@ void JsonParser::ParseValue(char_iterator& ch, char_iterator& end, Json* current
       if (ExpectKeyword(ch, end, "true"))
       {
         current->SetType(Json::ValueType::Bool);
-        current->value_ = true;
+        current->bool_ = true;
         parsing_state_ = ParsingState::Object;
         ch += 3;
       }
@@ -472,7 +862,7 @@ void JsonParser::ParseValue(char_iterator& ch, char_iterator& end, Json* current
       if (ExpectKeyword(ch, end, "false"))
       {
         current->SetType(Json::ValueType::Bool);
-        current->value_ = false;
+        current->bool_ = false;
         parsing_state_ = ParsingState::Object;
         ch += 4;
       }
@@ -503,7 +893,7 @@ void JsonParser::ParseValue(char_iterator& ch, char_iterator& end, Json* current
     case '[':
       current->SetType(Json::ValueType::Array);
       parsing_state_ = ParsingState::Array;
-      current->value_ = ChildrenList();
+      current->children_.clear();
       std::invoke(GetParsingMethod(parsing_state_), this, ++ch, end, current);
       return;
 
@@ -524,12 +914,77 @@ void JsonParser::ParseValue(char_iterator& ch, char_iterator& end, Json* current
       return;
 
     default:
-      value.append(1, *ch);
       break;
     }
 
     ch++;
   }
+
+  // The input ended before the value
+  if (ch == end) parsing_state_ = ParsingState::Undefined;
+}
+
+bool JsonParser::ParsePackedElement(char_iterator& ch, char_iterator& end, Json* current)
+{
+  using ElementType = JsonPackedArray::ElementType;
+
+  bool is_bool = *ch == 't' || *ch == 'f';
+  bool is_number = *ch == '-' || (*ch >= '0' && *ch <= '9');
+
+  if (!is_bool && !is_number) return false;
+
+  if (current->IsPacked())
+  {
+    // Mixed element kinds, fall back to child nodes
+    if (current->packed_->IsNumeric() == is_bool)
+    {
+      current->Unpack();
+      return false;
+    }
+  }
+  else if (!current->children_.empty())
+  {
+    return false;
+  }
+
+  if (is_bool)
+  {
+    bool value = *ch == 't';
+    std::string_view keyword = value ? "true" : "false";
+
+    if (!ExpectKeyword(ch, end, keyword))
+    {
+      parsing_state_ = ParsingState::Undefined;
+      return true;
+    }
+
+    if (!current->IsPacked()) current->StartPacked(ElementType::Bool);
+    current->packed_->AppendBool(value);
+
+    ch += keyword.size() - 1;
+    parsing_state_ = ParsingState::Object;
+    return true;
+  }
+
+  auto& value = number_buffer_;
+  value.clear();
+  if (!ReadNumber(ch, end, value))
+  {
+    // Consumed but failed, ParseArray stops on the state
+    parsing_state_ = ParsingState::Undefined;
+    return true;
+  }
+
+  int64_t integer = 0;
+  bool is_integer = ReadInteger(value, integer);
+
+  if (!current->IsPacked()) current->StartPacked(is_integer ? ElementType::Integer : ElementType::Number);
+
+  if (is_integer) current->packed_->AppendInteger(integer);
+  else current->packed_->AppendNumber(std::stod(value));
+
+  parsing_state_ = ParsingState::Object;
+  return true;
 }
 
 JsonParser::ParsingMethodType JsonParser::GetParsingMethod(ParsingState state)
@@ -546,21 +1001,11 @@ JsonParser::ParsingMethodType JsonParser::GetParsingMethod(ParsingState state)
   return nullptr;
 }
 
-bool JsonParser::ExpectKeyword(char_iterator& ch, char_iterator& end, std::string keyword)
+bool JsonParser::ExpectKeyword(char_iterator& ch, char_iterator& end, std::string_view keyword)
 {
-  std::string temp = "";
-
   if (static_cast<size_t>(end - ch) > keyword.size())
   {
-    temp.append(ch, ch + keyword.size());
-    if (keyword == temp)
-    {
-      return true;
-    }
-    else
-    {
-      return false;
-    }
+    return std::equal(keyword.begin(), keyword.end(), ch);
   }
 
   return false;
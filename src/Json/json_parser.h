@@ -2,15 +2,24 @@
 #define JSON_PARSER_H
 
 #include <string>
+#include <string_view>
 #include <memory>
 #include <thread>
+#include <vector>
 #include <iostream>
 #include "json.h"
+#include "json_stream.h"
 
 #define JSON_PROGESS_READ_TIME 1000
 
 
 
+/*
+ * A parser instance can be reused for many documents. Scratch buffers keep
+ * their capacity between Parse() calls and trees handed back with Recycle()
+ * refill a node pool that the next Parse() allocates from. An instance is not
+ * thread safe, keep one per thread (Json::Parse does).
+ */
 class JsonParser
 {
   using char_iterator = std::string::const_iterator;
@@ -18,7 +27,31 @@ class JsonParser
 
 public:
   JsonParser();
-  std::unique_ptr<Json> Parse(const std::string& data, const ProgresCallback& progress_callback);
+  explicit JsonParser(JsonAllocator& allocator);
+  std::unique_ptr<Json> Parse(const std::string& data, const ProgresCallback& progress_callback = ProgresCallback());
+
+  /*
+   * Parses the elements of the top level array, or of the array reached by following
+   * the object keys in path, one at a time:
+   *
+   *   for (auto& record : parser.ParseElements(file)) { ... }
+   *
+   * Only the current element is kept in memory; it is released on the next step
+   * unless moved out (Recycle() it to reuse the nodes). The parser and the input
+   * must outlive the generator.
+   */
+  JsonElementGenerator ParseElements(std::string_view data, std::vector<std::string> path = {});
+  JsonElementGenerator ParseElements(std::istream& input, std::vector<std::string> path = {});
+  JsonElementGenerator ParseElements(JsonChunkReader reader, std::vector<std::string> path = {});
+
+  /* Destroys a parsed tree, returning the nodes owned by the pool upstream to the pool */
+  void Recycle(std::unique_ptr<Json> json);
+
+  /* Clears the parsing state and counters and releases pooled memory */
+  void Reset();
+
+  /* Counters of the last Parse() call */
+  const JsonAllocationStats& GetAllocationStats() const;
 
 private:
   enum class ParsingState {
@@ -67,21 +100,37 @@ private:
     const char_iterator& end_;
   };
 
+  JsonElementGenerator StreamElements(std::unique_ptr<JsonStreamCursor> cursor, std::vector<std::string> path);
+  std::unique_ptr<Json> ParseElement(const std::string& text);
+
   /* Parsing methods */
   void ParseString(char_iterator& ch, char_iterator& end, Json* current);
   void ParseArray(char_iterator& ch, char_iterator& end, Json* current);
   void ParseObject(char_iterator& ch, char_iterator& end, Json* current);
   void ParseValue(char_iterator& ch, char_iterator& end, Json* current);
   void ParseNumber(char_iterator& ch, char_iterator& end, Json* current);
-  void ParseEscapeChar(char_iterator& ch, char_iterator& end, std::string& str);
+  bool ParseEscapeChar(char_iterator& ch, char_iterator& end, std::string& str);
+  bool ParseUnicodeEscape(char_iterator& ch, char_iterator& end, std::string& str);
+  bool ParsePackedElement(char_iterator& ch, char_iterator& end, Json* current);
+  bool ReadNumber(char_iterator& ch, char_iterator& end, std::string& value);
+  static bool ReadInteger(const std::string& value, int64_t& integer);
   ParsingMethodType GetParsingMethod(ParsingState state);
-  bool ExpectKeyword(char_iterator& ch, char_iterator& end, std::string expected_value);
+  bool ExpectKeyword(char_iterator& ch, char_iterator& end, std::string_view keyword);
 
   /* Maniputaion methods */
   void SetParsedValue(const std::string& value, Json* current);
   Json* AddNewPair(Json* current);
   std::atomic<bool> stop_flag_;
   std::atomic<ParsingState> parsing_state_;
+
+  JsonAllocator* allocator_;
+  JsonAllocationStats allocation_stats_;
+  JsonPoolAllocator node_pool_;
+
+  /* Reused between calls, strings and numbers never nest */
+  std::string string_buffer_;
+  std::string number_buffer_;
+  std::string element_buffer_;
 };
 
 
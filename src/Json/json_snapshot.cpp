@@ -0,0 +1,65 @@
+#include "json_snapshot.h"
+
+JsonSnapshot::JsonSnapshot()
+  : current_{ FrozenJson() }
+  , version_{ 0 }
+{
+}
+
+JsonSnapshot::JsonSnapshot(FrozenJson json)
+  : current_{ std::move(json) }
+  , version_{ 1 }
+{
+}
+
+void JsonSnapshot::Publish(FrozenJson json)
+{
+  current_.store(std::move(json), std::memory_order_release);
+  version_.fetch_add(1, std::memory_order_release);
+}
+
+void JsonSnapshot::Publish(std::unique_ptr<Json> json)
+{
+  Publish(Json::Freeze(std::move(json)));
+}
+
+FrozenJson JsonSnapshot::Load() const
+{
+  return current_.load(std::memory_order_acquire);
+}
+
+uint64_t JsonSnapshot::GetVersion() const
+{
+  return version_.load(std::memory_order_acquire);
+}
+
+JsonSnapshot::Reader::Reader(const JsonSnapshot& snapshot)
+  : snapshot_{ snapshot }
+  , cached_{}
+  , cached_version_{ 0 }
+{
+  Refresh();
+}
+
+const Json* JsonSnapshot::Reader::Get()
+{
+  return GetShared().get();
+}
+
+const FrozenJson& JsonSnapshot::Reader::GetShared()
+{
+  if (snapshot_.GetVersion() != cached_version_) Refresh();
+  return cached_;
+}
+
+uint64_t JsonSnapshot::Reader::GetVersion() const
+{
+  return cached_version_;
+}
+
+void JsonSnapshot::Reader::Refresh()
+{
+  // Version first: a newer document loaded below is picked up again on the next change
+  cached_version_ = snapshot_.GetVersion();
+  cached_ = snapshot_.Load();
+}
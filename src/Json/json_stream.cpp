@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <utility>
+
+#include "json_stream.h"
+
+JsonStreamCursor::JsonStreamCursor(std::string_view data)
+  : chunk_size_{ 0 }
+  , pos_{ data.data() }
+  , end_{ data.data() + data.size() }
+  , capture_{ nullptr }
+  , capture_start_{ nullptr }
+{
+}
+
+JsonStreamCursor::JsonStreamCursor(JsonChunkReader reader, size_t chunk_size)
+  : chunk_size_{ chunk_size > 0 ? chunk_size : kDefaultChunkSize }
+  , reader_{ std::move(reader) }
+  , pos_{ nullptr }
+  , end_{ nullptr }
+  , capture_{ nullptr }
+  , capture_start_{ nullptr }
+{
+}
+
+bool JsonStreamCursor::Expect(char ch)
+{
+  SkipWhitespace();
+  if (!Available() || *pos_ != ch) return false;
+
+  pos_++;
+  return true;
+}
+
+bool JsonStreamCursor::ReadString(std::string& value)
+{
+  value.clear();
+  if (!Expect('\"')) return false;
+
+  BeginCapture(value);
+  bool closed = ScanStringBody();
+  EndCapture();
+
+  // Drop the closing quote
+  if (closed) value.pop_back();
+  return closed;
+}
+
+bool JsonStreamCursor::SkipValue()
+{
+  return ScanValue();
+}
+
+bool JsonStreamCursor::CaptureValue(std::string& value)
+{
+  SkipWhitespace();
+
+  BeginCapture(value);
+  bool scanned = ScanValue();
+  EndCapture();
+
+  return scanned;
+}
+
+bool JsonStreamCursor::Available()
+{
+  if (pos_ != end_) return true;
+  if (!reader_) return false;
+
+  if (capture_ != nullptr)
+  {
+    capture_->append(capture_start_, end_);
+  }
+
+  chunk_.resize(chunk_size_);
+  size_t count = reader_(chunk_.data(), chunk_.size());
+
+  pos_ = chunk_.data();
+  end_ = pos_ + count;
+  capture_start_ = pos_;
+
+  return count > 0;
+}
+
+void JsonStreamCursor::SkipWhitespace()
+{
+  while (Available() && std::isspace(static_cast<unsigned char>(*pos_))) pos_++;
+}
+
+bool JsonStreamCursor::ScanValue()
+{
+  SkipWhitespace();
+  if (!Available()) return false;
+
+  char first = *pos_;
+
+  if (first == '\"')
+  {
+    pos_++;
+    return ScanStringBody();
+  }
+
+  if (first == '{' || first == '[')
+  {
+    size_t depth = 0;
+
+    while (Available())
+    {
+      char ch = *pos_++;
+
+      switch (ch)
+      {
+      case '\"':
+        if (!ScanStringBody()) return false;
+        break;
+      case '{':
+      case '[':
+        depth++;
+        break;
+      case '}':
+      case ']':
+        if (--depth == 0) return true;
+        break;
+      default:
+        break;
+      }
+    }
+    return false;
+  }
+
+  // Number, literal or garbage up to the next delimiter - the parser judges it
+  size_t length = 0;
+  while (Available())
+  {
+    char ch = *pos_;
+    if (ch == ',' || ch == '}' || ch == ']' || std::isspace(static_cast<unsigned char>(ch))) break;
+
+    pos_++;
+    length++;
+  }
+  return length > 0;
+}
+
+bool JsonStreamCursor::ScanStringBody()
+{
+  while (Available())
+  {
+    char ch = *pos_++;
+
+    if (ch == '\"') return true;
+    if (ch == '\\')
+    {
+      if (!Available()) return false;
+      pos_++;
+    }
+  }
+  return false;
+}
+
+void JsonStreamCursor::BeginCapture(std::string& value)
+{
+  capture_ = &value;
+  capture_start_ = pos_;
+}
+
+void JsonStreamCursor::EndCapture()
+{
+  capture_->append(capture_start_, pos_);
+  capture_ = nullptr;
+}
+
+JsonPipelinedReader::JsonPipelinedReader(JsonChunkReader source, size_t chunk_size, size_t chunk_count)
+  : source_{ std::move(source) }
+  , chunk_size_{ chunk_size > 0 ? chunk_size : JsonStreamCursor::kDefaultChunkSize }
+  , chunks_(std::max<size_t>(chunk_count, 1))
+  , head_{ 0 }
+  , count_{ 0 }
+  , head_offset_{ 0 }
+  , finished_{ false }
+{
+  for (auto& chunk : chunks_)
+  {
+    chunk.data = std::make_unique<char[]>(chunk_size_);
+  }
+
+  thread_ = std::jthread([this](std::stop_token stop_token) { Produce(stop_token); });
+}
+
+JsonPipelinedReader::~JsonPipelinedReader()
+{
+  thread_.request_stop();
+  thread_.join();
+}
+
+size_t JsonPipelinedReader::Read(char* buffer, size_t size)
+{
+  std::unique_lock lock{ mutex_ };
+  not_empty_.wait(lock, [this] { return count_ > 0 || finished_; });
+
+  if (count_ == 0)
+  {
+    if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+    return 0;
+  }
+
+  // The worker does not touch queued chunks, copy without holding the lock
+  auto& chunk = chunks_[head_];
+  size_t offset = head_offset_;
+  lock.unlock();
+
+  size_t copied = std::min(size, chunk.size - offset);
+  std::memcpy(buffer, chunk.data.get() + offset, copied);
+
+  lock.lock();
+  head_offset_ += copied;
+  if (head_offset_ == chunk.size)
+  {
+    head_ = (head_ + 1) % chunks_.size();
+    head_offset_ = 0;
+    count_--;
+    not_full_.notify_one();
+  }
+
+  return copied;
+}
+
+JsonChunkReader JsonPipelinedReader::GetReader()
+{
+  return [this](char* buffer, size_t size) { return Read(buffer, size); };
+}
+
+void JsonPipelinedReader::Produce(std::stop_token stop_token)
+{
+  while (true)
+  {
+    std::unique_lock lock{ mutex_ };
+    if (!not_full_.wait(lock, stop_token, [this] { return count_ < chunks_.size(); })) break;
+
+    auto& chunk = chunks_[(head_ + count_) % chunks_.size()];
+    lock.unlock();
+
+    size_t size = 0;
+    std::exception_ptr error;
+    try
+    {
+      size = source_(chunk.data.get(), chunk_size_);
+    }
+    catch (...)
+    {
+      error = std::current_exception();
+    }
+
+    lock.lock();
+    if (size == 0)
+    {
+      error_ = error;
+      break;
+    }
+
+    chunk.size = size;
+    count_++;
+    not_empty_.notify_one();
+  }
+
+  std::lock_guard lock{ mutex_ };
+  finished_ = true;
+  not_empty_.notify_all();
+}
+
+JsonElementGenerator JsonElementGenerator::promise_type::get_return_object()
+{
+  return JsonElementGenerator(handle_type::from_promise(*this));
+}
+
+std::suspend_always JsonElementGenerator::promise_type::yield_value(std::unique_ptr<Json> value) noexcept
+{
+  current_ = std::move(value);
+  return {};
+}
+
+void JsonElementGenerator::promise_type::unhandled_exception()
+{
+  exception_ = std::current_exception();
+}
+
+JsonElementGenerator::Iterator::Iterator(handle_type handle)
+  : handle_{ handle }
+{
+}
+
+std::unique_ptr<Json>& JsonElementGenerator::Iterator::operator*() const
+{
+  return handle_.promise().current_;
+}
+
+JsonElementGenerator::Iterator& JsonElementGenerator::Iterator::operator++()
+{
+  Resume(handle_);
+  return *this;
+}
+
+void JsonElementGenerator::Iterator::operator++(int)
+{
+  ++*this;
+}
+
+bool JsonElementGenerator::Iterator::operator==(std::default_sentinel_t) const
+{
+  return !handle_ || handle_.done();
+}
+
+JsonElementGenerator::JsonElementGenerator(handle_type handle)
+  : handle_{ handle }
+{
+}
+
+JsonElementGenerator::JsonElementGenerator(JsonElementGenerator&& other) noexcept
+  : handle_{ std::exchange(other.handle_, nullptr) }
+{
+}
+
+JsonElementGenerator& JsonElementGenerator::operator=(JsonElementGenerator&& other) noexcept
+{
+  if (this != &other)
+  {
+    if (handle_) handle_.destroy();
+    handle_ = std::exchange(other.handle_, nullptr);
+  }
+  return *this;
+}
+
+JsonElementGenerator::~JsonElementGenerator()
+{
+  if (handle_) handle_.destroy();
+}
+
+JsonElementGenerator::Iterator JsonElementGenerator::begin()
+{
+  if (handle_) Resume(handle_);
+  return Iterator(handle_);
+}
+
+std::default_sentinel_t JsonElementGenerator::end() const
+{
+  return std::default_sentinel;
+}
+
+void JsonElementGenerator::Resume(handle_type handle)
+{
+  handle.promise().current_.reset();
+  handle.resume();
+
+  if (handle.promise().exception_)
+  {
+    std::rethrow_exception(std::exchange(handle.promise().exception_, nullptr));
+  }
+}
@@ -0,0 +1,103 @@
+#include <stdexcept>
+#include <limits>
+
+#include "json_string.h"
+
+JsonString::JsonString() noexcept
+{
+  storage_[control_byte] = inline_capacity;
+}
+
+JsonString::JsonString(std::string_view str)
+{
+  storage_[control_byte] = inline_capacity;
+  Assign(str);
+}
+
+JsonString::JsonString(const JsonString& obj)
+{
+  storage_[control_byte] = inline_capacity;
+  Assign(obj.View());
+}
+
+JsonString::JsonString(JsonString&& obj) noexcept
+{
+  std::memcpy(storage_, obj.storage_, sizeof(storage_));
+  obj.storage_[control_byte] = inline_capacity;
+}
+
+JsonString& JsonString::operator=(const JsonString& obj)
+{
+  if (this != &obj) Assign(obj.View());
+  return *this;
+}
+
+JsonString& JsonString::operator=(JsonString&& obj) noexcept
+{
+  if (this != &obj)
+  {
+    Release();
+    std::memcpy(storage_, obj.storage_, sizeof(storage_));
+    obj.storage_[control_byte] = inline_capacity;
+  }
+  return *this;
+}
+
+JsonString::~JsonString()
+{
+  Release();
+}
+
+void JsonString::Assign(std::string_view str)
+{
+  if (str.size() <= inline_capacity)
+  {
+    // str may point into our own heap buffer, copy it before releasing
+    unsigned char buffer[inline_capacity];
+    std::memcpy(buffer, str.data(), str.size());
+    Release();
+    std::memcpy(storage_, buffer, str.size());
+    storage_[control_byte] = static_cast<unsigned char>(inline_capacity - str.size());
+    return;
+  }
+
+  if (str.size() > std::numeric_limits<uint32_t>::max())
+  {
+    throw std::length_error("JsonString: string too long");
+  }
+
+  char* data = static_cast<char*>(JsonAllocator::AllocateOwned(str.size(), alignof(char)));
+  std::memcpy(data, str.data(), str.size());
+  uint32_t size = static_cast<uint32_t>(str.size());
+
+  Release();
+  std::memcpy(storage_, &data, sizeof(data));
+  std::memcpy(storage_ + sizeof(data), &size, sizeof(size));
+  storage_[control_byte] = heap_tag;
+}
+
+void JsonString::Clear()
+{
+  Release();
+}
+
+void JsonString::Share(const JsonString& owner)
+{
+  if (this == &owner) return;
+
+  if (owner.IsInline())
+  {
+    Assign(owner.View());
+    return;
+  }
+
+  Release();
+  std::memcpy(storage_, owner.storage_, sizeof(storage_));
+  storage_[control_byte] = shared_tag;
+}
+
+void JsonString::Release()
+{
+  if (storage_[control_byte] == heap_tag) JsonAllocator::DeallocateOwned(HeapData(), HeapSize(), alignof(char));
+  storage_[control_byte] = inline_capacity;
+}
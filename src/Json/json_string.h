@@ -0,0 +1,120 @@
+#ifndef JSON_STRING_H
+#define JSON_STRING_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+
+#include "json_allocator.h"
+
+/*
+ * Compact string used for Json keys and string values.
+ * Occupies 16 bytes: up to 15 characters are stored inline, longer strings
+ * keep a pointer and a 32-bit length. The last byte tells the modes apart,
+ * a shared string borrows the heap buffer of another one (see Share).
+ */
+class JsonString {
+public:
+  static constexpr size_t inline_capacity = 15;
+
+  JsonString() noexcept;
+  JsonString(std::string_view str);
+  JsonString(const JsonString& obj);
+  JsonString(JsonString&& obj) noexcept;
+  JsonString& operator=(const JsonString& obj);
+  JsonString& operator=(JsonString&& obj) noexcept;
+  ~JsonString();
+
+  void Assign(std::string_view str);
+  void Clear();
+
+  /* Refers to the heap buffer of owner instead of copying it (short strings are
+     copied inline). owner must outlive this string and stay unchanged. */
+  void Share(const JsonString& owner);
+
+  const char* Data() const;
+  size_t Size() const;
+  bool Empty() const;
+  bool IsInline() const;
+  bool IsShared() const;
+
+  /* Bytes allocated outside the object, 0 for inline and shared strings */
+  size_t HeapBytes() const;
+
+  std::string_view View() const;
+  operator std::string_view() const;
+
+private:
+  static constexpr size_t control_byte = 15;
+  static constexpr unsigned char heap_tag = 0x80;
+  static constexpr unsigned char shared_tag = 0x81;
+
+  char* HeapData() const;
+  uint32_t HeapSize() const;
+  void Release();
+
+  alignas(8) unsigned char storage_[16];
+};
+
+
+inline bool JsonString::IsInline() const
+{
+  return storage_[control_byte] <= inline_capacity;
+}
+
+inline bool JsonString::IsShared() const
+{
+  return storage_[control_byte] == shared_tag;
+}
+
+inline const char* JsonString::Data() const
+{
+  return IsInline() ? reinterpret_cast<const char*>(storage_) : HeapData();
+}
+
+inline size_t JsonString::Size() const
+{
+  return IsInline() ? inline_capacity - storage_[control_byte] : HeapSize();
+}
+
+inline bool JsonString::Empty() const
+{
+  return Size() == 0;
+}
+
+inline size_t JsonString::HeapBytes() const
+{
+  return storage_[control_byte] == heap_tag ? HeapSize() : 0;
+}
+
+inline std::string_view JsonString::View() const
+{
+  return std::string_view(Data(), Size());
+}
+
+inline JsonString::operator std::string_view() const
+{
+  return View();
+}
+
+inline char* JsonString::HeapData() const
+{
+  char* data;
+  std::memcpy(&data, storage_, sizeof(data));
+  return data;
+}
+
+inline uint32_t JsonString::HeapSize() const
+{
+  uint32_t size;
+  std::memcpy(&size, storage_ + sizeof(char*), sizeof(size));
+  return size;
+}
+
+inline bool operator==(const JsonString& lhs, std::string_view rhs)
+{
+  return lhs.View() == rhs;
+}
+
+#endif // !JSON_STRING_H
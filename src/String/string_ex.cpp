@@ -1,2 +1,207 @@
 #include "string_ex.h"
 
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <new>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+  // Buffer start alignment only: reads begin at end_, after any unfinished line moved to the front
+  constexpr size_t kBufferAlignment = 4096;
+
+  char* AllocateAligned(size_t size)
+  {
+    return static_cast<char*>(::operator new[](size, std::align_val_t(kBufferAlignment)));
+  }
+
+  /* First '\n' in [first, last), or last. Four 16 byte compares are combined per 64 bytes. */
+  const char* FindNewline(const char* first, const char* last)
+  {
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    while (last - first >= 64)
+    {
+      auto chunk = reinterpret_cast<const __m128i*>(first);
+      __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128(chunk), newline);
+      __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128(chunk + 1), newline);
+      __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128(chunk + 2), newline);
+      __m128i d = _mm_cmpeq_epi8(_mm_loadu_si128(chunk + 3), newline);
+
+      if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d))) != 0)
+      {
+        uint64_t mask = static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(a)))
+          | static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(b))) << 16
+          | static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(c))) << 32
+          | static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(d))) << 48;
+        return first + std::countr_zero(mask);
+      }
+      first += 64;
+    }
+
+    while (last - first >= 16)
+    {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+      auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+      if (mask != 0) return first + std::countr_zero(mask);
+      first += 16;
+    }
+#endif
+
+    if (first == last) return last;
+
+    auto found = static_cast<const char*>(std::memchr(first, '\n', static_cast<size_t>(last - first)));
+    return found != nullptr ? found : last;
+  }
+}
+
+void Toolkit::LineReader::AlignedDelete::operator()(char* buffer) const
+{
+  ::operator delete[](buffer, std::align_val_t(kBufferAlignment));
+}
+
+Toolkit::LineReader::Iterator::Iterator(LineReader* reader)
+  : reader_{ reader }
+{
+  ++(*this);
+}
+
+std::string_view Toolkit::LineReader::Iterator::operator*() const
+{
+  return line_;
+}
+
+Toolkit::LineReader::Iterator& Toolkit::LineReader::Iterator::operator++()
+{
+  if (reader_ != nullptr && !reader_->Next(line_)) reader_ = nullptr;
+  return *this;
+}
+
+void Toolkit::LineReader::Iterator::operator++(int)
+{
+  ++(*this);
+}
+
+bool Toolkit::LineReader::Iterator::operator==(std::default_sentinel_t) const
+{
+  return reader_ == nullptr;
+}
+
+Toolkit::LineReader::LineReader(size_t block_size)
+  : capacity_{ block_size > kBufferAlignment ? block_size : kBufferAlignment }
+  , begin_{ 0 }
+  , scan_{ 0 }
+  , end_{ 0 }
+  , eof_{ true }
+  , error_{ false }
+{
+  buffer_.reset(AllocateAligned(capacity_));
+}
+
+bool Toolkit::LineReader::Open(const std::string& path)
+{
+  Close();
+
+  // Unbuffered, block reads go straight into the line buffer
+  file_.rdbuf()->pubsetbuf(nullptr, 0);
+  file_.open(std::filesystem::path((const char8_t*)path.c_str()), std::ios::binary);
+  if (!file_) return false;
+
+  eof_ = false;
+  return true;
+}
+
+void Toolkit::LineReader::Close()
+{
+  if (file_.is_open()) file_.close();
+  file_.clear();
+
+  begin_ = 0;
+  scan_ = 0;
+  end_ = 0;
+  eof_ = true;
+  error_ = false;
+}
+
+bool Toolkit::LineReader::IsOpen() const
+{
+  return file_.is_open();
+}
+
+bool Toolkit::LineReader::Next(std::string_view& line)
+{
+  while (true)
+  {
+    const char* data = buffer_.get();
+    const char* newline = FindNewline(data + scan_, data + end_);
+
+    if (newline != data + end_)
+    {
+      line = std::string_view(data + begin_, static_cast<size_t>(newline - data) - begin_);
+      begin_ = scan_ = static_cast<size_t>(newline - data) + 1;
+      return true;
+    }
+
+    scan_ = end_;
+
+    if (eof_)
+    {
+      if (begin_ == end_) return false;
+
+      line = std::string_view(data + begin_, end_ - begin_);
+      begin_ = scan_ = end_;
+      return true;
+    }
+
+    Refill();
+  }
+}
+
+bool Toolkit::LineReader::HasError() const
+{
+  return error_;
+}
+
+Toolkit::LineReader::Iterator Toolkit::LineReader::begin()
+{
+  return Iterator(this);
+}
+
+std::default_sentinel_t Toolkit::LineReader::end() const
+{
+  return std::default_sentinel;
+}
+
+void Toolkit::LineReader::Refill()
+{
+  // Only the unfinished line is moved, to the front of the buffer
+  size_t pending = end_ - begin_;
+  if (begin_ > 0 && pending > 0) std::memmove(buffer_.get(), buffer_.get() + begin_, pending);
+
+  scan_ -= begin_;
+  begin_ = 0;
+  end_ = pending;
+
+  if (end_ == capacity_)
+  {
+    std::unique_ptr<char[], AlignedDelete> grown{ AllocateAligned(capacity_ * 2) };
+    std::memcpy(grown.get(), buffer_.get(), end_);
+
+    buffer_ = std::move(grown);
+    capacity_ *= 2;
+  }
+
+  file_.read(buffer_.get() + end_, static_cast<std::streamsize>(capacity_ - end_));
+  end_ += static_cast<size_t>(file_.gcount());
+
+  if (!file_)
+  {
+    eof_ = true;
+    error_ = file_.bad();
+  }
+}
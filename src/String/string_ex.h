@@ -1,11 +1,82 @@
 #ifndef STRING_EX_H
 #define STRING_EX_H
 
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <string_view>
 
 namespace Toolkit{
 
+  /*
+   * Line by line reading of large text files without a copy per line.
+   * The file is read in large blocks into one aligned buffer and lines are
+   * found with a 64 bytes per step newline scan (SSE2, memchr elsewhere).
+   * Lines are views into the buffer, valid until the next line is read. Only
+   * the unfinished line at the end of a block is moved before the next read,
+   * the buffer grows when a single line does not fit. '\r' is left in place.
+   */
+  class LineReader {
+  public:
+    static constexpr size_t kDefaultBlockSize = 1024 * 1024;
 
+    class Iterator {
+    public:
+      using value_type = std::string_view;
+      using difference_type = std::ptrdiff_t;
+
+      Iterator() = default;
+      explicit Iterator(LineReader* reader);
+
+      std::string_view operator*() const;
+      Iterator& operator++();
+      void operator++(int);
+      bool operator==(std::default_sentinel_t) const;
+
+    private:
+      LineReader* reader_ = nullptr;
+      std::string_view line_;
+    };
+
+    explicit LineReader(size_t block_size = kDefaultBlockSize);
+
+    LineReader(const LineReader&) = delete;
+    LineReader& operator=(const LineReader&) = delete;
+
+    /* Closes the previous file, the buffer is kept */
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const;
+
+    /* Next line without its '\n', false at the end of the file.
+       A last line without '\n' is still returned. */
+    bool Next(std::string_view& line);
+
+    /* Whether reading stopped on an I/O error rather than at the end */
+    bool HasError() const;
+
+    /* Iterate once per Open() */
+    Iterator begin();
+    std::default_sentinel_t end() const;
+
+  private:
+    struct AlignedDelete {
+      void operator()(char* buffer) const;
+    };
+
+    void Refill();
+
+    std::ifstream file_;
+    std::unique_ptr<char[], AlignedDelete> buffer_;
+    size_t capacity_;
+    size_t begin_;  // Start of the next line
+    size_t scan_;   // Where the newline search resumes
+    size_t end_;
+    bool eof_;
+    bool error_;
+  };
 }
 
 #endif // STRING_EX_H
@@ -0,0 +1,396 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "filesystem_batch_read.h"
+#include "filesystem_copy.h"
+#include "filesystem_ex.h"
+#include "filesystem_hash.h"
+#include "json.h"
+#include "json_allocator.h"
+#include "json_builder.h"
+#include "json_parser.h"
+#include "json_packed_array.h"
+
+/*
+ * toolkit_tests - regression cases, exits with the number of failed checks.
+ */
+
+namespace {
+  int failures = 0;
+
+  void Check(bool condition, const std::string& what)
+  {
+    if (condition) return;
+
+    std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+    failures++;
+  }
+
+  bool IsParseError(const std::unique_ptr<Json>& json)
+  {
+    return json == nullptr || !json->IsValid();
+  }
+
+  void TruncatedInputIsRejected()
+  {
+    const std::vector<std::string> inputs = {
+      "[1", "[1.5", "[1,2,3", "[\"abc", "{\"a\":[1", "{\"a\":1", "{\"a\":\"b",
+      "[true", "[true,false", "[null", "[\"a\"", "[1,", "[[1,2]", "[{\"a\":1}",
+      "{\"a\"", "{\"a\":", "{\"a\":true", "{\"a\":{\"b\":1}", "[\"a\\", "[-", "{\"a\":1.5e",
+    };
+
+    for (const auto& input : inputs)
+    {
+      Check(IsParseError(Json::Parse(input)), "truncated input rejected: " + input);
+    }
+  }
+
+  void CompleteInputIsAccepted()
+  {
+    const std::vector<std::string> inputs = {
+      "[1]", "[1.5, 2]", "[true,false]", "[\"abc\"]", "[]", "{}", "[[1],[true]]",
+      "{\"a\":1}", "{\"a\":[1,2],\"b\":\"x\",\"c\":null}",
+    };
+
+    for (const auto& input : inputs)
+    {
+      Check(!IsParseError(Json::Parse(input)), "complete input accepted: " + input);
+    }
+  }
+
+  const JsonPackedArray* GetPacked(const Json& json)
+  {
+    auto value = json.GetValue();
+    auto packed = std::get_if<const JsonPackedArray*>(&value);
+    return packed != nullptr ? *packed : nullptr;
+  }
+
+  void PackMatchesParser()
+  {
+    using ElementType = JsonPackedArray::ElementType;
+
+    // Unpacked and packed again, the element type stays the one the parser picked from the text
+    for (std::string text : { "[1,2,3]", "[1.0,2]", "[1e3]", "[-0]", "[-0,1]", "[1.5,2]", "[9223372036854775808]" })
+    {
+      auto parsed = Json::Parse(text);
+      if (parsed == nullptr || GetPacked(*parsed) == nullptr)
+      {
+        Check(false, "numeric array is packed by the parser: " + text);
+        continue;
+      }
+
+      auto type = GetPacked(*parsed)->GetElementType();
+      auto first = GetPacked(*parsed)->NumberAt(0);
+
+      parsed->Unpack();
+      bool packed = parsed->Pack() && parsed->IsPacked();
+      Check(packed && GetPacked(*parsed)->GetElementType() == type, "Pack() element type matches the parser: " + text);
+      Check(packed && std::signbit(GetPacked(*parsed)->NumberAt(0)) == std::signbit(first), "Pack() keeps the sign of zero: " + text);
+    }
+
+    Check(GetPacked(*Json::Parse("[-0]"))->GetElementType() == ElementType::Number, "-0 is parsed as a Number");
+
+    Json integers;
+    for (int value : { 1, 2, 3 }) integers.AddValue(value);
+    Check(integers.Pack() && GetPacked(integers)->GetElementType() == ElementType::Integer, "integral values pack as Integer");
+
+    Json numbers;
+    for (double value : { 1.0, 2.0 }) numbers.AddValue(value);
+    Check(numbers.Pack() && GetPacked(numbers)->GetElementType() == ElementType::Number, "double values pack as Number");
+  }
+
+  void PackedElementViewsAreDetached()
+  {
+    auto array = Json::Parse("[1,2,3]");
+    auto hash = array->Hash();
+
+    size_t visited = 0;
+    array->ForEachChild([&](const Json& element, size_t index) {
+      element.Hash();
+      Check(element.GetParent() == nullptr && element.IsArrayElement(), "packed element view has no parent");
+      Check(element.IsLastChild() == (index == 2) && element.ToString() == std::to_string(static_cast<double>(index + 1)), "packed element view position and value");
+      visited++;
+      });
+
+    Check(visited == 3 && array->Hash() == hash, "visiting packed elements leaves the array hash alone");
+  }
+
+  void BuilderMovesKeysFromRvalueRanges()
+  {
+    std::vector<std::pair<JsonString, int>> pairs;
+    pairs.emplace_back(JsonString(std::string_view("a key too long to be stored inline")), 1);
+    pairs.emplace_back(JsonString(std::string_view("another key too long to be stored inline")), 2);
+
+    Json copied;
+    JsonBuilder(copied, Json::ValueType::Object).Append(pairs);
+    Check(!pairs[0].first.Empty() && copied["a key too long to be stored inline"] != nullptr, "keys of an lvalue range are copied");
+
+    Json moved;
+    JsonBuilder(moved, Json::ValueType::Object).Append(std::move(pairs));
+    Check(pairs[0].first.Empty() && pairs[1].first.Empty(), "keys of an rvalue range are moved");
+    Check(moved["another key too long to be stored inline"] != nullptr, "moved keys are looked up");
+  }
+
+  void TreesReturnMemoryToTheirAllocator()
+  {
+    const std::string text = "{\"a string too long to be stored inline\":[1,2,3],\"b\":[{\"c\":\"another long string value\"}]}";
+
+    JsonCountingAllocator counting{ JsonAllocator::Default() };
+    std::unique_ptr<Json> parsed;
+    std::unique_ptr<Json> built;
+    {
+      JsonAllocatorScope scope{ counting };
+      parsed = Json::Parse(text);
+      built = std::make_unique<Json>(*parsed);
+    }
+    Check(counting.GetStats().allocations > 0, "a tree built in a scope allocates from it");
+
+    parsed.reset();
+    built.reset();
+    auto stats = counting.GetStats();
+    Check(stats.live_bytes == 0 && stats.deallocations == stats.allocations, "a tree destroyed outside its scope is released to its allocator");
+
+    // Trees owned by another allocator pass through a pool installed later
+    JsonCountingAllocator upstream{ JsonAllocator::Default() };
+    JsonPoolAllocator pool{ JsonAllocator::GetOwnedSize(sizeof(Json), alignof(Json)), 16, upstream };
+    {
+      JsonAllocatorScope scope{ pool };
+      built = std::make_unique<Json>();
+    }
+    {
+      JsonAllocatorScope scope{ counting };
+      built.reset();
+    }
+    Check(pool.GetCachedBlocks() == 0 && upstream.GetStats().live_bytes == 0, "a pool block goes back to the pool upstream");
+
+    {
+      JsonAllocatorScope scope{ pool };
+      built = std::make_unique<Json>();
+      built.reset();
+    }
+    Check(pool.GetCachedBlocks() == 1, "a pool installed over the owner caches its blocks");
+
+    JsonParser parser;
+    parsed = parser.Parse(text);
+    Check(parser.GetAllocationStats().allocations > 0, "a parse reports its allocations");
+    parser.Recycle(std::move(parsed));
+    parsed = parser.Parse(text);
+    parser.Reset();
+    parsed.reset();
+  }
+
+  void DigestIgnoresBlockSize()
+  {
+    using Algorithm = Toolkit::FileHashOptions::Algorithm;
+
+    auto path = (std::filesystem::temp_directory_path() / "toolkit_tests_hash.bin").string();
+    {
+      std::ofstream file(path, std::ios::binary | std::ios::trunc);
+      for (size_t i = 0; i < 200 * 1024; i++) file.put(static_cast<char>(i * 31 + i / 977));
+    }
+
+    for (auto algorithm : { Algorithm::Fast, Algorithm::Sha256 })
+    {
+      Toolkit::FileHashOptions small{ .algorithm = algorithm, .thread_count = 1, .block_size = 4096 };
+      Toolkit::FileHashOptions large{ .algorithm = algorithm, .thread_count = 1 };
+
+      auto a = Toolkit::FileHasher(small).Hash({ path });
+      auto b = Toolkit::FileHasher(large).Hash({ path });
+      Check(a.size() == 1 && b.size() == 1 && a[0].valid && a[0] == b[0], "file digest does not depend on block_size");
+    }
+
+    std::filesystem::remove(path);
+  }
+
+  void DuplicatesSkipEmptyFiles()
+  {
+    auto dir = std::filesystem::temp_directory_path() / "toolkit_tests_duplicates";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    for (const char* name : { "empty1", "empty2" }) std::ofstream(dir / name);
+    for (const char* name : { "same1", "same2" }) std::ofstream(dir / name) << "same content";
+
+    auto duplicates = Toolkit::FileHasher().FindDuplicates(dir.string());
+    Check(duplicates.size() == 1 && duplicates[0].size == 12, "empty files are not reported as duplicates");
+
+    Toolkit::FileHashOptions options{ .include_empty = true };
+    duplicates = Toolkit::FileHasher(options).FindDuplicates(dir.string());
+    Check(duplicates.size() == 2 && duplicates[1].size == 0 && duplicates[1].paths.size() == 2, "include_empty groups empty files");
+
+    std::filesystem::remove_all(dir);
+  }
+
+  void BatchReadMatchesFiles()
+  {
+    auto dir = std::filesystem::temp_directory_path() / "toolkit_tests_batch";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    std::vector<std::string> paths;
+    std::vector<std::string> contents;
+    for (size_t size : { 0, 3, 4096, 100000, 300000 })
+    {
+      std::string content;
+      for (size_t i = 0; i < size; i++) content += static_cast<char>('a' + i % 26);
+
+      paths.push_back((dir / ("file" + std::to_string(size))).string());
+      contents.push_back(content);
+      std::ofstream(paths.back(), std::ios::binary) << content;
+    }
+    paths.push_back((dir / "missing").string());
+
+    for (bool use_io_uring : { true, false })
+    {
+      auto backend = std::string(use_io_uring ? "io_uring" : "threads") + ": ";
+      Toolkit::FileBatchReader reader({ .queue_depth = 2, .thread_count = 2, .read_size = 4096, .use_io_uring = use_io_uring });
+
+      // The second pass reads into the recycled buffers of the first
+      for (int pass = 0; pass < 2; pass++)
+      {
+        auto files = reader.Read(paths);
+        Check(files.size() == paths.size() && files.back().error == ENOENT, backend + "missing file reports ENOENT");
+        for (size_t i = 0; i + 1 < files.size() && i < contents.size(); i++)
+        {
+          Check(files[i].error == 0 && files[i].data == contents[i], backend + "batch read content of " + paths[i]);
+          Check(files[i].data.capacity() <= std::max<size_t>(files[i].data.size() * 2, 15), backend + "batch read capacity of " + paths[i]);
+        }
+        if (!use_io_uring) Check(!reader.UsedIoUring(), backend + "thread backend used");
+
+        // Reversed, so small files get the large recycled buffers
+        std::reverse(files.begin(), files.end());
+        reader.Recycle(std::move(files));
+      }
+
+      std::vector<std::vector<char>> storage;
+      for (size_t capacity : { 10, 10, 10, 200000, 300000, 10 }) storage.emplace_back(capacity);
+
+      std::vector<std::span<char>> buffers(storage.begin(), storage.end());
+      std::vector<int64_t> sizes(paths.size());
+      reader.Read(paths, buffers, sizes);
+
+      for (size_t i = 0; i < contents.size(); i++)
+      {
+        auto expected = std::min(contents[i].size(), storage[i].size());
+        Check(sizes[i] == static_cast<int64_t>(expected) && std::string_view(storage[i].data(), expected) == std::string_view(contents[i]).substr(0, expected),
+          backend + "caller buffer read of " + paths[i]);
+      }
+      Check(sizes.back() == -ENOENT, backend + "caller buffer read of a missing file");
+    }
+
+    std::filesystem::remove_all(dir);
+  }
+
+  void WalkFollowEntersDirectoriesOnce()
+  {
+    auto dir = std::filesystem::temp_directory_path() / "toolkit_tests_walk";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir / "real" / "sub");
+    std::ofstream(dir / "real" / "sub" / "file") << "x";
+    std::filesystem::create_directory_symlink("real", dir / "link");
+
+    for (size_t thread_count : { 1, 4 })
+    {
+      size_t files = 0;
+      Toolkit::WalkOptions options{ .symlinks = Toolkit::WalkOptions::Symlinks::Follow, .thread_count = thread_count };
+      Toolkit::Filesystem::Walk(dir.string(), options, [&files](std::span<const Toolkit::WalkEntry> entries) {
+        for (const auto& entry : entries) files += entry.GetName() == "file";
+        return true;
+        });
+
+      Check(files == 1, "a directory reached directly and through a link is walked once");
+    }
+
+    std::filesystem::remove_all(dir);
+  }
+
+  void CopyReportsUnreadableDirectories()
+  {
+    namespace fs = std::filesystem;
+
+    auto dir = fs::temp_directory_path() / "toolkit_tests_copy";
+    fs::remove_all(dir);
+    fs::create_directories(dir / "from" / "locked");
+    std::ofstream(dir / "from" / "locked" / "file") << "x";
+    std::ofstream(dir / "from" / "file") << "x";
+    fs::permissions(dir / "from" / "locked", fs::perms::none);
+
+    // Permissions do not stop a privileged user from listing it
+    std::error_code error;
+    fs::directory_iterator probe(dir / "from" / "locked", error);
+    if (error)
+    {
+      auto result = Toolkit::FileCopier().Copy((dir / "from").string(), (dir / "to").string());
+      Check(!result.Succeeded() && result.failures.size() == 1 && result.failures[0].path.ends_with("locked"),
+        "an unreadable directory is a copy failure");
+      Check(fs::exists(dir / "to" / "file"), "the readable part is still copied");
+    }
+
+    fs::permissions(dir / "from" / "locked", fs::perms::owner_all);
+    if (fs::exists(dir / "to" / "locked")) fs::permissions(dir / "to" / "locked", fs::perms::owner_all);
+    fs::remove_all(dir);
+  }
+
+  void DiskUsageDoesNotCacheUnreadableDirectories()
+  {
+    namespace fs = std::filesystem;
+
+    auto dir = fs::temp_directory_path() / "toolkit_tests_usage";
+    fs::remove_all(dir);
+    fs::create_directories(dir / "root" / "locked");
+    std::ofstream(dir / "root" / "locked" / "file") << "data";
+
+    // Old enough to be cached right away
+    auto old_time = fs::file_time_type::clock::now() - std::chrono::hours(1);
+    fs::last_write_time(dir / "root" / "locked", old_time);
+    fs::permissions(dir / "root" / "locked", fs::perms::none);
+
+    std::error_code error;
+    fs::directory_iterator probe(dir / "root" / "locked", error);
+    if (error)
+    {
+      Toolkit::DiskUsageOptions options{ .cache_path = (dir / "cache").string() };
+      auto root = (dir / "root").string();
+      auto locked = (dir / "root" / "locked").string();
+
+      Toolkit::Filesystem::DiskUsage(root, options);
+      fs::permissions(dir / "root" / "locked", fs::perms::owner_all);
+
+      auto report = Toolkit::Filesystem::DiskUsage(root, options);
+      auto usage = report.Find(locked);
+      Check(usage != nullptr && usage->own.files == 1, "an unreadable directory is listed again once readable");
+    }
+
+    fs::permissions(dir / "root" / "locked", fs::perms::owner_all);
+    fs::remove_all(dir);
+  }
+}
+
+int main()
+{
+  TruncatedInputIsRejected();
+  CompleteInputIsAccepted();
+  PackMatchesParser();
+  PackedElementViewsAreDetached();
+  BuilderMovesKeysFromRvalueRanges();
+  TreesReturnMemoryToTheirAllocator();
+  DigestIgnoresBlockSize();
+  DuplicatesSkipEmptyFiles();
+  BatchReadMatchesFiles();
+  WalkFollowEntersDirectoriesOnce();
+  CopyReportsUnreadableDirectories();
+  DiskUsageDoesNotCacheUnreadableDirectories();
+
+  if (failures == 0) std::printf("all checks passed\n");
+  return failures;
+}